@@ -1,13 +1,29 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdint.h>
+#include <string.h>
+#include <threads.h>
 #include <time.h>
-
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// building with -DHEADLESS leaves out everything that touches SDL, so the
+// simulation can run on machines without a display (see `make headless`)
+#ifndef HEADLESS
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_hints.h>
+#endif
 
 typedef unsigned int uint;
 typedef uint8_t u8;
@@ -25,12 +41,26 @@ my_malloc(size_t size) {
 	assert(ret != NULL);
 	return ret;
 }
+
+void *
+my_realloc(void *ptr, size_t size) {
+	void *ret = realloc(ptr, size);
+	assert(ret != NULL);
+	return ret;
+}
 #define malloc my_malloc
+#define realloc my_realloc
 
+#ifndef HEADLESS
 SDL_Window *win = NULL;
 SDL_Renderer *ren = NULL;
 SDL_Event ev;
 
+// the map is drawn as one pixel per tile into map_pixels, which is
+// uploaded to map_texture and stretched over the window
+SDL_Texture *map_texture = NULL;
+u32 *map_pixels = NULL;
+
 void
 sdl_set_color(u32 color) {
 	SDL_SetRenderDrawColor(ren,
@@ -39,6 +69,7 @@ sdl_set_color(u32 color) {
 			       (color >>  8) & 0xff,
 			       (color >>  0) & 0xff);
 }
+#endif
 
 typedef enum {
 	None,
@@ -63,325 +94,1247 @@ typedef enum {
 	TileTypesN
 } TileType;
 
+// xoshiro128** seeded through splitmix64. every guy carries its own so
+// what it does only depends on its own history, not on update order
+typedef struct {
+	u32 s[4];
+} Rng;
+
 #define ALIVEGUY_CELLS_W 16
 #define ALIVEGUY_CELLS_H 16
 typedef struct {
-	int x;
+	u8 x;
+	u8 y;
+	u8 type;
+} BodyCell;
+
+// a guy's cells, CELL_BITS per cell: cell x of row y sits at bit
+// x * CELL_BITS of rows[y]
+#define CELL_BITS 2
+#define CELL_MASK 3u
+_Static_assert(CellTypesN <= 1 << CELL_BITS, "every cell type fits in CELL_BITS");
+typedef struct {
+	u32 rows[ALIVEGUY_CELLS_H];
+
+	// cached from rows by body_recalculate, which runs whenever the
+	// body changes
+	u16 cells_amount;
+	u8 start_x;
+	u8 start_y;
+	u8 end_x;
+	u8 end_y;
+	// kept 0 so equal bodies are equal bytes, in snapshots too
+	u8 unused[6];
+} Body;
+
+// walks the non None cells of a body in row order
+typedef struct {
+	Body *body;
 	int y;
-
+	u32 left;
+} BodyIter;
+
+// bodies are shared: every guy points at a Genome, and guys with the same
+// body point at the same one. a genome never changes once made, a child
+// that mutates gets the one matching the body it ends up with, made if
+// nobody has it yet. each genome is a species, its refs the population.
+// genomes are kept in pages of GENOME_PAGE so pointers to them stay good
+// as the table grows
+#define GENOME_PAGE 1024
+typedef struct {
+	Body body;
+	// guys using it, 0 when the slot is free
+	int refs;
+	// guys ever given it, and the tick it was made
+	long births;
+	u64 first_tick;
+	u32 hash;
+	// next genome in its hash bucket, or in the free list
+	int next;
+
+	// worked out from body once, when the genome is made, so the hot
+	// paths don't redo it for every guy every tick: what a guy of this
+	// kind lives and needs to eat, its rows as one bit per cell for the
+	// collision tests, and its cells grouped by type for the cell
+	// kernels, the ones of type t being cells[type_start[t]] up to
+	// cells[type_start[t + 1]], each group in row order
 	int lifetime;
-	int hp;
-	int food_consumed;
-
-	Direction moving_direction;
-	int moving_frames_left;
-
-	CellType cells[ALIVEGUY_CELLS_W * ALIVEGUY_CELLS_H];
-} AliveGuy;
+	int food_needed;
+	u16 row_masks[ALIVEGUY_CELLS_H];
+	BodyCell cells[ALIVEGUY_CELLS_W * ALIVEGUY_CELLS_H];
+	u16 type_start[CellTypesN + 1];
+	// the empty cells touching a cell, sides or corners, that a mutation
+	// may add a cell on, one bit per cell like row_masks. row and column
+	// 0 are never in it
+	u16 frontier[ALIVEGUY_CELLS_H];
+	int frontier_amount;
+} Genome;
 
 typedef struct {
-	TileType *tiles;
+	Genome **pages;
+	int pages_amount;
+	// slots handed out so far, freed ones are chained from free_head
+	int amount;
+	int free_head;
+	// first genome of each hash bucket, -1 when empty. buckets_amount
+	// is a power of two and grows to stay above species
+	int *buckets;
+	int buckets_amount;
+	// genomes in use
+	int species;
+} GenomeTable;
+
+// the guys, one array per field, indexed by slot. capacity slots, of
+// which free_slots is a stack of the unused ones and alive_slots lists
+// the used ones densely, alive_slots_pos[i] being where slot i sits in it
+typedef struct {
+	int capacity;
+
+	int *x;
+	int *y;
+	// the tick the guy dies on, 0 while it isn't on Game::death_wheel.
+	// wheel_next and wheel_prev chain the guys dying on ticks that share
+	// its wheel slot, -1 at the ends
+	u64 *death_tick;
+	int *wheel_next;
+	int *wheel_prev;
+	int *hp;
+	int *food_consumed;
+	u8 *moving_direction;
+	u8 *moving_frames_left;
+	// the guy's home rect, ry * game_get_rects_with_guys_w() + rx, -1
+	// when not registered
+	int *rect_index;
+	Rng *rng;
+	// index into Game::genomes, -1 for free slots
+	int *genome;
+
+	int *free_slots;
+	int free_amount;
+	int *alive_slots;
+	int *alive_slots_pos;
+	int alives;
+} AliveGuys;
+
+// what isn't a bit per tile is kept per TILEMAP_CHUNK x TILEMAP_CHUNK
+// chunk, and only for chunks something has touched, so a big mostly empty
+// map costs little more than its planes. a chunk is a parallel block's
+// square, but the guys of a block also touch the chunks next to it, as
+// their bodies and food stamps spill over. no two blocks next to each
+// other run in the same phase, so still only one thread at a time
+// allocates or writes a chunk
+#define TILEMAP_CHUNK 64
+// chunks left with nobody in them give their occupants back every this
+// many ticks, not as soon as they empty, so a guy moving about a chunk
+// of its own doesn't free and allocate it every step
+#define TILEMAP_CHUNK_FREE_TICKS 64
+typedef struct {
+	// index of the guy whose cell sits on each tile, -1 when nobody's
+	// there, and how many tiles aren't -1. NULL while nobody's there
+	int *occupants;
+	int occupants_amount;
+
+	// tiles whose tile type or occupant changed since the renderer last
+	// looked, bit x of word y, and whether there are any. NULL until
+	// then, and not kept in headless builds
+	u64 *dirty;
+	bool is_dirty;
+} TileChunk;
+
+// tiles are kept as one bit per tile in a Food and a Wall plane, a tile
+// being Empty when it's in neither. each row of a plane is row_words
+// words long, padded so every row starts on its own cache line
+#define TILEMAP_ROW_ALIGN 64
+typedef struct {
+	u64 *food;
+	u64 *wall;
+	// set where a guy's cell is, for the collision tests
+	u64 *occupied;
+	int row_words;
+
 	int w;
 	int h;
+
+	TileChunk *chunks;
+	int chunks_w;
+	int chunks_h;
 } TileMap;
 
+// the map is cut into rects of this many tiles. every alive guy's home is
+// the rect holding the top left corner of its cells' bounding box, which
+// the parallel update uses to hand guys out to blocks
 #define RECT_WITH_GUYS_W 16
 #define RECT_WITH_GUYS_H 16
+
+// where a tick's time goes. the phases are timed only while
+// Game::profiling is set, the vacancy checks are always counted
+typedef enum {
+	PhaseTick,       // all of game_update, wall clock
+	PhaseMove,       // the movers' kernel, the collision check and the move
+	PhaseReproduce,  // looking for a spot for a child
+	PhaseMutate,     // aliveguy_guy_mutate
+	PhaseCells,      // the other cell kernels
+	PhaseRender,     // game_render
+	PhasesN
+} ProfilePhase;
+
+char *profile_phase_names[PhasesN] = {
+	"tick", "move", "reproduce", "mutate", "cells", "render"
+};
+
 typedef struct {
-	int amount;
-	int indices[64];
-} RectWithGuys;
+	u64 ns[PhasesN];
+	long ticks;
+	long frames;
+	long point_vacant_calls;
+	long spot_vacant_calls;
+} Profile;
+
+// what aliveguy_guy_mutate does to a body
+typedef enum {
+	AddCell,
+	ChangeCell,
+	RemoveCell,
+	MutationsN
+} Mutation;
+
+// the event log is a file starting with EVENTLOG_MAGIC, a u32 version and
+// a u32 sizeof(Event), followed by Events in the order they happened.
+// fields not listed for a type are 0
+typedef enum {
+	EventBirth,     // guy born at x, y, value is its parent
+	EventDeath,     // guy died at x, y, value is how many cells it had
+	EventMutation,  // guy's cell at x, y of its body went from `from` to
+	                // `to` by kind, logged right before the guy's birth
+	EventFood,      // value food tiles on the map, guy is the alive count
+	EventTypesN
+} EventType;
+
+char *event_type_names[EventTypesN] = {
+	"birth", "death", "mutation", "food"
+};
+
+typedef struct {
+	u64 tick;
+	i64 value;
+	i32 guy;
+	i32 x;
+	i32 y;
+	u8 type;
+	u8 kind;
+	u8 from;
+	u8 to;
+} Event;
+
+#define EVENTLOG_MAGIC "LIFELOG"
+#define EVENTLOG_VERSION 1
+// events are handed to the writer thread this many at a time
+#define EVENTLOG_CHUNK 16384
+// chunks the writer may fall behind by before the sim waits for it
+#define EVENTLOG_MAX_QUEUED 64
+// food is counted every this many ticks, it's a pass over the whole map
+#define EVENTLOG_FOOD_TICKS 64
 
+typedef struct {
+	FILE *file;
+
+	// filled by the sim, owned by it
+	Event *filling;
+	int filling_amount;
+
+	// full chunks waiting for the writer, and emptied ones to reuse
+	Event *queued[EVENTLOG_MAX_QUEUED];
+	int queued_amount;
+	Event **spare;
+	int spare_amount;
+	int spare_capacity;
+
+	thrd_t writer;
+	mtx_t lock;
+	cnd_t wake;
+	cnd_t drained;
+	bool quit;
+	bool failed;
+} EventLog;
+
+// default capacity of the guy pool, and the most it can be
 #define GUYS_N 2048
+#define GUYS_MAX (1 << 24)
+// default map size in tiles. maps smaller than MAP_MIN_SIZE wouldn't fit
+// the first guy. MAP_MAX_TILES keeps every count of tiles, rects and
+// chunks well inside an int
+#define MAP_W (RECT_WITH_GUYS_W * 10)
+#define MAP_H (RECT_WITH_GUYS_H * 10)
+#define MAP_MIN_SIZE (ALIVEGUY_CELLS_W * 4)
+#define MAP_MAX_TILES ((i64) 1 << 28)
+// guys due to die on tick t are chained from death_wheel[t %
+// DEATH_WHEEL_SLOTS]. lifetimes longer than the wheel just stay chained
+// until their tick comes round
+#define DEATH_WHEEL_SLOTS 4096
+
 typedef struct {
-	int alives;
-	AliveGuy guys[GUYS_N];
+	int parent;
+	int x;
+	int y;
+} BirthRequest;
+
+typedef struct {
+	AliveGuys guys;
+	GenomeTable genomes;
+
+	// children asked for this tick, placed together once every guy has
+	// had its turn. births[i] is what guy i asked for, parent -1 when it
+	// didn't. a guy only writes its own, so blocks can ask at once
+	BirthRequest *births;
+
+	// first guy of each slot, -1 when empty, and scratch for the ones
+	// dying this tick
+	int *death_wheel;
+	int *dying;
 
-	RectWithGuys *rects_with_guys;
 	TileMap *map;
 
 	int mutation_chance_percent;
+
+	// ticks run since the world was made, carried over by snapshots
+	u64 tick;
+
+	// NULL when nothing's logged
+	EventLog *log;
+
+	// gathered since whoever reads it last reset it. the phases summed
+	// over threads can add up to more than PhaseTick
+	bool profiling;
+	Profile profile;
+
+	// NULL when game_update runs on a single thread
+	struct Workers *workers;
 } Game;
 
+// the parallel update splits the world into blocks of
+// PARALLEL_BLOCK_RECTS x PARALLEL_BLOCK_RECTS rects and runs every guy
+// from the block holding its home rect. a guy touches tiles up to about
+// 21 tiles above / left of its home and 37 below / right of it (its own
+// cells, their neighbours, and where a child of it may land), so blocks
+// PARALLEL_PHASE_STRIDE apart in both directions never touch the same
+// tile or rect and are updated at the same time, in
+// PARALLEL_PHASE_STRIDE^2 phases per tick. blocks are 64 tiles wide, so
+// they also never share a word of the tile planes, and are the tile map's
+// chunks, so a chunk is only touched by its own block and its neighbours
+#define PARALLEL_BLOCK_RECTS 4
+#define PARALLEL_PHASE_STRIDE 3
+_Static_assert(PARALLEL_BLOCK_RECTS * RECT_WITH_GUYS_W == TILEMAP_CHUNK &&
+	       PARALLEL_BLOCK_RECTS * RECT_WITH_GUYS_H == TILEMAP_CHUNK,
+	       "a parallel block is one tile map chunk");
+
+typedef struct {
+	// this tick's guys, a range of Workers::guys in alive slot order
+	int guys_start;
+	int guys_amount;
+
+	// added to Game::profile once the phase is over
+	Profile profile;
+} Block;
+
+typedef struct Workers {
+	Game *game;
+
+	int blocks_w;
+	int blocks_h;
+	Block *blocks;
+	int *guys;
+
+	// blocks of the phase being run, workers take them in turns
+	int *phase_blocks;
+	int phase_blocks_amount;
+	atomic_int next_phase_block;
+
+	thrd_t *threads;
+	int threads_amount;
+	mtx_t lock;
+	cnd_t start;
+	cnd_t done;
+	int generation;
+	int running;
+	bool quit;
+} Workers;
+
+// set on the threads running a block of the parallel update, where
+// profile counts go to the block
+_Thread_local Block *current_block = NULL;
+
+// what the world starts as. founder is the one guy game_init makes, empty
+// has nobody, dense packs copies of the founder until the pool is nearly
+// full and walls is the founder in a grid of walls with gaps in them
+typedef enum {
+	ScenarioFounder,
+	ScenarioEmpty,
+	ScenarioDense,
+	ScenarioWalls,
+	ScenariosN
+} Scenario;
+
+char *scenario_names[ScenariosN] = {
+	"founder", "empty", "dense", "walls"
+};
+
+typedef struct {
+	// headless limits, < 0 means no limit
+	long ticks;
+	double seconds;
+
+	// window speed, tps <= 0 runs as many ticks as fit between frames
+	// and fps <= 0 only draws when asked to (r key)
+	double tps;
+	double fps;
+
+	int threads;
+	u64 seed;
+	int width;
+	int height;
+	int capacity;
+	Scenario scenario;
+
+	// start from this snapshot rather than a new world, NULL makes one
+	char *load_path;
+	// where events are logged, NULL doesn't
+	char *log_path;
+
+	// where snapshots are written, every save_every ticks when headless
+	// (<= 0 doesn't) and on the s key in the window
+	char *snapshot_path;
+	long save_every;
+
+	// headless: print the profile every profile_every ticks, as csv lines
+	// or as json objects, one per line. <= 0 doesn't
+	long profile_every;
+	bool profile_json;
+
+	// headless: list this many of the most populous species at the end
+	int species;
+} Options;
+
+// a snapshot is a SnapshotHeader followed by sections, each starting
+// SNAPSHOT_ALIGN aligned at the offset the header gives so a mapped file
+// can be read in place: the food and wall planes as they're kept in the
+// TileMap, the alive slots, the free slot stack, and then one section per
+// field in SnapshotField order holding the alive guys' values in alive
+// slot order. occupants and rects aren't stored, they're rebuilt on load
+#define SNAPSHOT_MAGIC "LIFESNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+#define SNAPSHOT_ALIGN 64
+#define SNAPSHOT_GUY_FIELDS 9
+#define SNAPSHOT_SECTIONS (4 + SNAPSHOT_GUY_FIELDS)
+
+typedef struct {
+	char magic[8];
+	u32 version;
+	// SNAPSHOT_BYTE_ORDER as the writer had it, snapshots are only read
+	// on machines of the same byte order
+	u32 byte_order;
+	u64 tick;
+	i32 w;
+	i32 h;
+	i32 row_words;
+	i32 capacity;
+	i32 alives;
+	i32 free_amount;
+	i32 mutation_chance_percent;
+	i32 body_size;
+	u64 offsets[SNAPSHOT_SECTIONS];
+	u64 sizes[SNAPSHOT_SECTIONS];
+	u64 file_size;
+} SnapshotHeader;
+
+typedef struct {
+	void *base;
+	size_t size;
+} SnapshotField;
+
+// longest the window spends simulating before it handles events again
+#define SIM_SLICE_SECONDS (1 / 60.0)
+// ticks owed beyond this many are dropped when the sim can't keep up
+#define SIM_MAX_BACKLOG_TICKS 8
+// the profile overlay shows averages over this long
+#define PROFILE_OVERLAY_SECONDS 0.5
+
 int game_get_rects_with_guys_w(Game *game);
 int game_get_rects_with_guys_h(Game *game);
-void aliveguy_init(AliveGuy *guy);
-CellType aliveguy_get_cell(AliveGuy *guy, int x, int y);
-void aliveguy_set_cell(AliveGuy *guy, int x, int y, CellType cell);
+int game_aliveguy_rect_index(Game *game, int index);
+void rng_seed(Rng *rng, u64 seed);
+u32 rng_next(Rng *rng);
+u32 rng_below(Rng *rng, u32 n);
+void body_init(Body *body);
+CellType body_get_cell(Body *body, int x, int y);
+void body_set_cell(Body *body, int x, int y, CellType cell);
+u32 body_row_cells(u32 row);
+u32 body_row_mask(u32 row);
+void body_recalculate(Body *body);
+void body_iter_init(BodyIter *it, Body *body);
+int body_iter_next(BodyIter *it, BodyCell *cell);
+BodyCell body_nth_cell(Body *body, int n);
+void genome_table_init(GenomeTable *table);
+void genome_table_free(GenomeTable *table);
+Genome * genome_get(GenomeTable *table, int id);
+u32 body_hash(Body *body);
+void genome_table_grow_buckets(GenomeTable *table);
+void genome_derive(Genome *genome);
+int genome_cells_of(Genome *genome, CellType type);
+int genome_intern(GenomeTable *table, Body *body, u64 tick);
+void genome_acquire(GenomeTable *table, int id);
+void genome_release(GenomeTable *table, int id);
+void genome_table_print_species(GenomeTable *table, int amount);
+Genome * aliveguy_genome(Game *game, int index);
+Body * aliveguy_body(Game *game, int index);
+void aliveguy_init(Game *game, int index);
 u32 get_cell_color(CellType t);
-void aliveguy_render(AliveGuy *guy);
-int aliveguy_cells_amount(AliveGuy *guy);
-int aliveguy_starting_x(AliveGuy *guy);
-int aliveguy_starting_y(AliveGuy *guy);
-int aliveguy_ending_x(AliveGuy *guy);
-int aliveguy_ending_y(AliveGuy *guy);
-void cell_update(CellType cell, int x, int y, AliveGuy *guy, int index, Game *game);
-void aliveguy_calculate_new_lifetime(AliveGuy *guy);
-int aliveguy_food_needed_to_reproduce(AliveGuy *guy);
-int aliveguy_occupies_point(AliveGuy *guy, int x, int y);
+void cell_kernel_produce(Game *game, int index, BodyCell *cells, int amount, int clip);
+void cell_kernel_move(Game *game, int index, BodyCell *cells, int amount, int clip);
+void cell_kernel_eat(Game *game, int index, BodyCell *cells, int amount, int clip);
+void aliveguy_calculate_new_lifetime(Game *game, int index);
+void aliveguy_set_lifetime(Game *game, int index, int ticks);
+void game_schedule_death(Game *game, int index);
+void game_unschedule_death(Game *game, int index);
+int compare_ints(const void *a, const void *b);
+void game_kill_due(Game *game);
+int aliveguy_food_needed_to_reproduce(Game *game, int index);
 int game_is_point_vacant(Game *game, int x, int y);
-int aliveguy_is_spot_vacant(AliveGuy *guy, int x, int y, Game *game);
-void game_aliveguy_register_birth(Game *game, AliveGuy *aliveguy);
-void aliveguy_guy_mutate(AliveGuy *guy, Game *game);
-void aliveguy_birth(AliveGuy *guy, int x, int y, Game *game);
-int aliveguy_try_reproduce(AliveGuy *guy, int index, Game *game);
-void aliveguy_tostring(AliveGuy *guy);
-void aliveguy_update(AliveGuy *guy, int index, Game *game);
+int aliveguy_is_spot_vacant(Genome *genome, int x, int y, int ignore, Game *game);
+void game_aliveguy_set_occupants(Game *game, int index, int occupant);
+void game_aliveguy_register_birth(Game *game, int index);
+void game_aliveguy_register_move(Game *game, int index, int x, int y);
+void game_aliveguy_register_death(Game *game, int index);
+void aliveguy_guy_mutate(Game *game, int index, Genome *genome, Body *body);
+void aliveguy_birth(Game *game, int parent, int x, int y);
+int aliveguy_try_reproduce(Game *game, int index);
+void aliveguy_tostring(Game *game, int index);
+int aliveguy_clips(Game *game, int index);
+void aliveguy_update(Game *game, int index);
+int tilemap_row_words(int w);
 TileMap * make_tilemap(int w, int h);
-TileType * tilemap_get_tile_ptr(TileMap *map, int x, int y);
+TileChunk * tilemap_get_chunk(TileMap *map, int x, int y);
+void tilemap_mark_dirty(TileMap *map, int x, int y);
 TileType tilemap_get_tile(TileMap *map, int x, int y);
 void tilemap_set_tile(TileMap *map, int x, int y, TileType t);
+u64 tilemap_word_mask(int word, int x0, int x1);
+long tilemap_count_food(TileMap *map, int x, int y, int w, int h);
+void tilemap_fill_region(TileMap *map, int x, int y, int w, int h, TileType t);
+void tilemap_stamp_food(TileMap *map, int x, int y, Body *body);
+int tilemap_get_occupant(TileMap *map, int x, int y);
+void tilemap_set_occupant(TileMap *map, int x, int y, int occupant);
+void tilemap_free_empty_chunks(TileMap *map);
 u32 get_tile_color(TileType t);
-void tilemap_render(TileMap *map);
-void game_init(Game *game);
+#ifndef HEADLESS
+u32 game_get_tile_render_color(Game *game, int x, int y);
+void tilemap_render(Game *game);
+void tilemap_render_reset(void);
+#endif
+void game_alloc(Game *game, int w, int h, int capacity);
+void game_init(Game *game, u64 seed, int w, int h, int capacity);
+void game_free(Game *game);
+void game_setup_scenario(Game *game, Scenario scenario, u64 seed);
+#ifndef HEADLESS
 void game_render(Game *game);
-AliveGuy * game_new_aliveguy(Game *game);
+#endif
+int game_new_aliveguy(Game *game);
+void game_free_aliveguy(Game *game, int index);
+void snapshot_guy_fields(AliveGuys *guys, SnapshotField *fields);
+bool game_save(Game *game, char *path);
+Game * game_load(char *path);
+void game_start_workers(Game *game, int threads);
+void game_stop_workers(Game *game);
+int workers_thread(void *arg);
+void workers_take_blocks(Workers *workers);
+void workers_run_phase(Workers *workers);
+void block_update(Game *game, Block *block);
+void game_update_parallel(Game *game);
+void game_place_births(Game *game);
 void game_update(Game *game);
+double now_seconds(void);
+u64 now_ns(void);
+Profile * game_profile(Game *game);
+u64 profile_start(Game *game);
+void profile_stop(Game *game, ProfilePhase phase, u64 start);
+void profile_reset(Profile *profile);
+void profile_add(Profile *dst, Profile *src);
+void profile_print(Profile *profile, long tick, int alives, bool json, bool header);
+#ifndef HEADLESS
+void profile_render_overlay(Profile *profile, int alives);
+#endif
+void options_init(Options *opts);
+void options_usage(char *argv0);
+void options_parse(Options *opts, int argc, char *argv[]);
+Game * game_from_options(Options *opts);
+EventLog * eventlog_open(char *path);
+void eventlog_push(EventLog *log, Event *event);
+void eventlog_hand_over(EventLog *log);
+int eventlog_writer(void *arg);
+void eventlog_close(EventLog *log);
+int eventlog_print(char *path);
+void game_log_event(Game *game, Event *event);
+void game_log_birth(Game *game, int child, int parent);
+void game_log_death(Game *game, int index);
+void game_log_mutation(Game *game, int index, Mutation kind, int x, int y, CellType from, CellType to);
+void game_log_food(Game *game);
+
+// the four tiles next to one, in the order moving_direction picks them
+const int neighbour_dx[4] = { -1, 1,  0, 0 };
+const int neighbour_dy[4] = {  0, 0, -1, 1 };
+
+// what each cell type does, run by aliveguy_update in this order and
+// timed as phase. a new cell type needs an entry here, and if it doesn't
+// fit in CELL_BITS a wider encoding, which means Body::rows,
+// body_row_cells, body_row_mask and the bit tricks built on them in
+// body_recalculate and body_iter_next change too. it also needs a colour
+// in get_cell_color and a letter in aliveguy_tostring
+typedef void (*CellKernel)(Game *game, int index, BodyCell *cells, int amount, int clip);
+typedef struct {
+	CellKernel run;
+	ProfilePhase phase;
+} CellKernelEntry;
+
+const CellKernelEntry cell_kernels[CellTypesN] = {
+	[None]     = { NULL,                PhasesN    },
+	[Producer] = { cell_kernel_produce, PhaseCells },
+	[Mover]    = { cell_kernel_move,    PhaseMove  },
+	[Eater]    = { cell_kernel_eat,     PhaseCells },
+};
+
+void
+rng_seed(Rng *rng, u64 seed) {
+	for (int i = 0; i < 4; i++) {
+		// splitmix64
+		seed += 0x9e3779b97f4a7c15;
+		u64 z = seed;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		z = z ^ (z >> 31);
+		rng->s[i] = z >> 32;
+	}
+}
+
+u32
+rng_next(Rng *rng) {
+	u32 *s = rng->s;
+	u32 x = s[1] * 5;
+	u32 result = ((x << 7) | (x >> 25)) * 9;
+	u32 t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 11) | (s[3] >> 21);
+
+	return result;
+}
+
+// uniform enough in [0, n) for the small n used here, without a division
+u32
+rng_below(Rng *rng, u32 n) {
+	return ((u64) rng_next(rng) * n) >> 32;
+}
 
 int
 game_get_rects_with_guys_w(Game *game) {
-	return game->map->w / RECT_WITH_GUYS_W;
+	// the last column of rects may be cut short by the map's edge
+	return (game->map->w + RECT_WITH_GUYS_W - 1) / RECT_WITH_GUYS_W;
 }
 
 int
 game_get_rects_with_guys_h(Game *game) {
-	return game->map->h / RECT_WITH_GUYS_H;
+	return (game->map->h + RECT_WITH_GUYS_H - 1) / RECT_WITH_GUYS_H;
 }
 
-void
-aliveguy_init(AliveGuy *guy) {
-	guy->x = 0;
-	guy->y = 0;
-	guy->lifetime = 0;
-	guy->hp = 0;
-	guy->food_consumed = 0;
-	guy->moving_direction = Left;
-	guy->moving_frames_left = 0;
+int
+game_aliveguy_rect_index(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	Body *body = aliveguy_body(game, index);
+	int rx = (guys->x[index] + body->start_x) / RECT_WITH_GUYS_W;
+	int ry = (guys->y[index] + body->start_y) / RECT_WITH_GUYS_H;
+	assert(0 <= rx && rx < game_get_rects_with_guys_w(game) &&
+	       0 <= ry && ry < game_get_rects_with_guys_h(game));
+	return ry * game_get_rects_with_guys_w(game) + rx;
+}
 
-	for (int i = 0; i < ALIVEGUY_CELLS_W * ALIVEGUY_CELLS_H; i++) {
-		guy->cells[i] = None;
+void
+body_init(Body *body) {
+	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
+		body->rows[y] = 0;
 	}
+	body_recalculate(body);
 }
 
 CellType
-aliveguy_get_cell(AliveGuy *guy, int x, int y) {
+body_get_cell(Body *body, int x, int y) {
 	assert(x < ALIVEGUY_CELLS_W && y < ALIVEGUY_CELLS_H);
 	assert(0 <= x && 0 <= y);
-	return guy->cells[y * ALIVEGUY_CELLS_W + x];
+	return (body->rows[y] >> (x * CELL_BITS)) & CELL_MASK;
 }
 
 void
-aliveguy_set_cell(AliveGuy *guy, int x, int y, CellType cell) {
+body_set_cell(Body *body, int x, int y, CellType cell) {
 	assert(x < ALIVEGUY_CELLS_W && y < ALIVEGUY_CELLS_H);
 	assert(0 <= x && 0 <= y);
-	guy->cells[y * ALIVEGUY_CELLS_W + x] = cell;
+	if (body_get_cell(body, x, y) == cell) {
+		return;
+	}
+
+	body->rows[y] &= ~(CELL_MASK << (x * CELL_BITS));
+	body->rows[y] |= (u32) cell << (x * CELL_BITS);
+	body_recalculate(body);
 }
 
+// the low bit of every cell that isn't None
 u32
-get_cell_color(CellType t) {
-	switch (t) {
-	case None : assert(0);
-	case Producer : return 0x55cc55ff;
-	case Eater    : return 0xdead00ff;
-	case Mover    : return 0x00deadff;
-	default : assert(0);
-	}
-	assert(0);
+body_row_cells(u32 row) {
+	return (row | (row >> 1)) & 0x55555555;
+}
+
+// one bit per cell that isn't None, cell x at bit x
+u32
+body_row_mask(u32 row) {
+	u32 m = body_row_cells(row);
+	m = (m | (m >> 1)) & 0x33333333;
+	m = (m | (m >> 2)) & 0x0f0f0f0f;
+	m = (m | (m >> 4)) & 0x00ff00ff;
+	m = (m | (m >> 8)) & 0x0000ffff;
+	return m;
 }
 
 void
-aliveguy_render(AliveGuy *guy) {
+body_recalculate(Body *body) {
+	body->cells_amount = 0;
+	body->start_x = ALIVEGUY_CELLS_W;
+	body->start_y = ALIVEGUY_CELLS_H;
+	body->end_x = 0;
+	body->end_y = 0;
+	memset(body->unused, 0, sizeof(body->unused));
+
 	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+		u32 row = body->rows[y];
+		u32 cells = body_row_cells(row);
+		if (cells == 0) {
+			continue;
+		}
 
-			if (cell == None) {
-				continue;
-			}
+		body->cells_amount += __builtin_popcount(cells);
 
-			u32 color = get_cell_color(cell);
-			sdl_set_color(color);
-			SDL_FRect rect = {
-				(guy->x + x) * 10,
-				(guy->y + y) * 10,
-				10 - 1,
-				10 - 1
-			};
-			SDL_RenderFillRect(ren, &rect);
-		}
+		int sx = __builtin_ctz(cells) / CELL_BITS;
+		int ex = (31 - __builtin_clz(cells)) / CELL_BITS;
+		if (sx < body->start_x) { body->start_x = sx; }
+		if (y < body->start_y) { body->start_y = y; }
+		if (ex > body->end_x) { body->end_x = ex; }
+		if (y > body->end_y) { body->end_y = y; }
 	}
 }
 
+void
+body_iter_init(BodyIter *it, Body *body) {
+	it->body = body;
+	it->y = body->start_y - 1;
+	it->left = 0;
+}
+
 int
-aliveguy_cells_amount(AliveGuy *guy) {
-	int ret = 0;
+body_iter_next(BodyIter *it, BodyCell *cell) {
+	while (it->left == 0) {
+		it->y += 1;
+		if (it->y >= ALIVEGUY_CELLS_H) {
+			return 0;
+		}
+		it->left = body_row_cells(it->body->rows[it->y]);
+	}
+
+	int bit = __builtin_ctz(it->left);
+	it->left &= it->left - 1;
+
+	cell->x = bit / CELL_BITS;
+	cell->y = it->y;
+	cell->type = (it->body->rows[it->y] >> bit) & CELL_MASK;
+	return 1;
+}
+
+// the n-th non None cell in row order
+BodyCell
+body_nth_cell(Body *body, int n) {
+	assert(0 <= n && n < body->cells_amount);
 
 	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+		u32 cells = body_row_cells(body->rows[y]);
+		int amount = __builtin_popcount(cells);
+		if (n >= amount) {
+			n -= amount;
+			continue;
+		}
 
-			if (cell != None) {
-				ret += 1;
-			}
+		for (; n > 0; n--) {
+			cells &= cells - 1;
 		}
+
+		BodyCell ret;
+		ret.x = __builtin_ctz(cells) / CELL_BITS;
+		ret.y = y;
+		ret.type = body_get_cell(body, ret.x, ret.y);
+		return ret;
 	}
 
-	return ret;
+	assert(0);
 }
 
-int
-aliveguy_starting_x(AliveGuy *guy) {
+void
+genome_table_init(GenomeTable *table) {
+	table->pages = NULL;
+	table->pages_amount = 0;
+	table->amount = 0;
+	table->free_head = -1;
+	table->buckets_amount = 256;
+	table->buckets = my_malloc(sizeof(int) * table->buckets_amount);
+	for (int i = 0; i < table->buckets_amount; i++) {
+		table->buckets[i] = -1;
+	}
+	table->species = 0;
+}
+
+void
+genome_table_free(GenomeTable *table) {
+	for (int i = 0; i < table->pages_amount; i++) {
+		free(table->pages[i]);
+	}
+	free(table->pages);
+	free(table->buckets);
+}
+
+Genome *
+genome_get(GenomeTable *table, int id) {
+	assert(0 <= id && id < table->amount);
+	return &table->pages[id / GENOME_PAGE][id % GENOME_PAGE];
+}
+
+u32
+body_hash(Body *body) {
+	u32 h = 2166136261u;
 	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+		h = (h ^ body->rows[y]) * 16777619u;
+		h ^= h >> 15;
+	}
+	return h;
+}
 
-			if (cell != None) {
-				return x;
-			}
-		}
+void
+genome_table_grow_buckets(GenomeTable *table) {
+	free(table->buckets);
+	table->buckets_amount *= 2;
+	table->buckets = my_malloc(sizeof(int) * table->buckets_amount);
+	for (int i = 0; i < table->buckets_amount; i++) {
+		table->buckets[i] = -1;
 	}
 
-	assert(0);
+	for (int id = 0; id < table->amount; id++) {
+		Genome *genome = genome_get(table, id);
+		if (genome->refs == 0) {
+			continue;
+		}
+		int bucket = genome->hash & (table->buckets_amount - 1);
+		genome->next = table->buckets[bucket];
+		table->buckets[bucket] = id;
+	}
 }
 
-int
-aliveguy_starting_y(AliveGuy *guy) {
+// fills in what's worked out from the genome's body
+void
+genome_derive(Genome *genome) {
+	Body *body = &genome->body;
+	genome->lifetime = body->cells_amount * 80;
+	genome->food_needed = body->cells_amount * 15;
 	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+		genome->row_masks[y] = body_row_mask(body->rows[y]);
+	}
 
-			if (cell != None) {
-				return y;
+	int n = 0;
+	for (int type = 0; type < CellTypesN; type++) {
+		genome->type_start[type] = n;
+		BodyIter it;
+		BodyCell bc;
+		body_iter_init(&it, body);
+		while (body_iter_next(&it, &bc)) {
+			if (bc.type == type) {
+				genome->cells[n++] = bc;
 			}
 		}
 	}
+	genome->type_start[CellTypesN] = n;
+	assert(n == body->cells_amount);
+
+	genome->frontier_amount = 0;
+	genome->frontier[0] = 0;
+	for (int y = 1; y < ALIVEGUY_CELLS_H; y++) {
+		u32 around = genome->row_masks[y - 1] | genome->row_masks[y];
+		if (y + 1 < ALIVEGUY_CELLS_H) {
+			around |= genome->row_masks[y + 1];
+		}
+		around |= (around << 1) | (around >> 1);
+		genome->frontier[y] = around & ~genome->row_masks[y] & 0xfffe;
+		genome->frontier_amount += __builtin_popcount(genome->frontier[y]);
+	}
+}
 
-	assert(0);
+// how many of the genome's cells are of type
+int
+genome_cells_of(Genome *genome, CellType type) {
+	return genome->type_start[type + 1] - genome->type_start[type];
 }
 
+// the genome with this body, made if there's none, with one more ref
 int
-aliveguy_ending_x(AliveGuy *guy) {
-	for (int y = ALIVEGUY_CELLS_H - 1; y >= 0 ; y--) {
-		for (int x = ALIVEGUY_CELLS_W - 1; x >= 0 ; x--) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+genome_intern(GenomeTable *table, Body *body, u64 tick) {
+	u32 hash = body_hash(body);
+	int bucket = hash & (table->buckets_amount - 1);
+	for (int id = table->buckets[bucket]; id != -1; id = genome_get(table, id)->next) {
+		Genome *genome = genome_get(table, id);
+		if (genome->hash == hash &&
+		    memcmp(genome->body.rows, body->rows, sizeof(body->rows)) == 0) {
+			genome_acquire(table, id);
+			return id;
+		}
+	}
 
-			if (cell != None) {
-				return x;
-			}
+	int id;
+	if (table->free_head != -1) {
+		id = table->free_head;
+		table->free_head = genome_get(table, id)->next;
+	} else {
+		if (table->amount == table->pages_amount * GENOME_PAGE) {
+			table->pages_amount += 1;
+			table->pages = my_realloc(table->pages,
+						  sizeof(Genome *) * table->pages_amount);
+			table->pages[table->pages_amount - 1] =
+				my_malloc(sizeof(Genome) * GENOME_PAGE);
 		}
+		id = table->amount;
+		table->amount += 1;
 	}
 
-	assert(0);
+	Genome *genome = genome_get(table, id);
+	genome->body = *body;
+	genome_derive(genome);
+	genome->refs = 0;
+	genome->births = 0;
+	genome->first_tick = tick;
+	genome->hash = hash;
+	genome->next = table->buckets[bucket];
+	table->buckets[bucket] = id;
+	table->species += 1;
+	genome_acquire(table, id);
+
+	if (table->species > table->buckets_amount) {
+		genome_table_grow_buckets(table);
+	}
+
+	return id;
 }
 
-int
-aliveguy_ending_y(AliveGuy *guy) {
-	for (int y = ALIVEGUY_CELLS_H - 1; y >= 0 ; y--) {
-		for (int x = ALIVEGUY_CELLS_W - 1; x >= 0 ; x--) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
+void
+genome_acquire(GenomeTable *table, int id) {
+	Genome *genome = genome_get(table, id);
+	genome->refs += 1;
+	genome->births += 1;
+}
 
-			if (cell != None) {
-				return y;
-			}
+// the genome is unlinked and its slot reused once nobody has it
+void
+genome_release(GenomeTable *table, int id) {
+	Genome *genome = genome_get(table, id);
+	assert(genome->refs > 0);
+	genome->refs -= 1;
+	if (genome->refs > 0) {
+		return;
+	}
+
+	int *link = &table->buckets[genome->hash & (table->buckets_amount - 1)];
+	while (*link != id) {
+		assert(*link != -1);
+		link = &genome_get(table, *link)->next;
+	}
+	*link = genome->next;
+
+	genome->next = table->free_head;
+	table->free_head = id;
+	table->species -= 1;
+}
+
+// the `amount` most populous species as csv
+void
+genome_table_print_species(GenomeTable *table, int amount) {
+	int *top = my_malloc(sizeof(int) * (amount > 0 ? amount : 1));
+	int top_amount = 0;
+
+	for (int id = 0; id < table->amount; id++) {
+		Genome *genome = genome_get(table, id);
+		if (genome->refs == 0) {
+			continue;
+		}
+
+		int i = top_amount < amount ? top_amount : amount - 1;
+		if (i < 0 || (top_amount == amount &&
+			      genome_get(table, top[i])->refs >= genome->refs)) {
+			continue;
+		}
+		for (; i > 0 && genome_get(table, top[i - 1])->refs < genome->refs; i--) {
+			top[i] = top[i - 1];
+		}
+		top[i] = id;
+		if (top_amount < amount) {
+			top_amount += 1;
 		}
 	}
 
+	printf("species,population,births,first_tick,cells\n");
+	for (int i = 0; i < top_amount; i++) {
+		Genome *genome = genome_get(table, top[i]);
+		printf("%d,%d,%ld,%llu,%d\n", top[i], genome->refs, genome->births,
+		       (unsigned long long) genome->first_tick,
+		       genome->body.cells_amount);
+	}
+
+	free(top);
+}
+
+Genome *
+aliveguy_genome(Game *game, int index) {
+	return genome_get(&game->genomes, game->guys.genome[index]);
+}
+
+Body *
+aliveguy_body(Game *game, int index) {
+	return &aliveguy_genome(game, index)->body;
+}
+
+void
+aliveguy_init(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	guys->x[index] = 0;
+	guys->y[index] = 0;
+	guys->death_tick[index] = 0;
+	guys->wheel_next[index] = -1;
+	guys->wheel_prev[index] = -1;
+	guys->hp[index] = 0;
+	guys->food_consumed[index] = 0;
+	guys->moving_direction[index] = Left;
+	guys->moving_frames_left[index] = 0;
+	guys->rect_index[index] = -1;
+	guys->genome[index] = -1;
+}
+
+u32
+get_cell_color(CellType t) {
+	switch (t) {
+	case None : assert(0);
+	case Producer : return 0x55cc55ff;
+	case Eater    : return 0xdead00ff;
+	case Mover    : return 0x00deadff;
+	default : assert(0);
+	}
 	assert(0);
 }
 
+// the kernels run the guy's cells of one type, in CellType order, each
+// in one go. clip says the neighbours of the cells may be off the map,
+// it's clear when the guy and the ring of tiles around it are all on it
+
+// a producer of a guy that doesn't move puts food on each empty tile next
+// to it with a chance of 1 in 2, and does so at all only every other
+// tick on average. its 5 coin flips come out of one draw of the rng, 6
+// producers to a draw
 void
-cell_update(CellType cell, int x, int y, AliveGuy *guy, int index, Game *game) {
+cell_kernel_produce(Game *game, int index, BodyCell *cells, int amount, int clip) {
 	TileMap *t = game->map;
+	AliveGuys *guys = &game->guys;
+	if (genome_cells_of(aliveguy_genome(game, index), Mover) > 0) {
+		return;
+	}
 
-	struct pt { int x; int y; };
-	struct pt arr[4] = {
-		{guy->x + x - 1, guy->y + y    },
-		{guy->x + x + 1, guy->y + y    },
-		{guy->x + x    , guy->y + y - 1},
-		{guy->x + x    , guy->y + y + 1}
-	};
-
-	switch (cell) {
-	case None : assert(0);
-	case Producer : {
-		if ((rand() % 2) < 1) {
-			return;
+	Rng *rng = &guys->rng[index];
+	u32 flips = 0;
+	int flips_left = 0;
+	for (int i = 0; i < amount; i++) {
+		if (flips_left < 5) {
+			flips = rng_next(rng);
+			flips_left = 32;
+		}
+		u32 cell_flips = flips;
+		flips >>= 5;
+		flips_left -= 5;
+		if (!(cell_flips & 1)) {
+			continue;
 		}
 
-		TileType *ptr;
-		for(int i = 0; i < 4; i++) {
-			ptr = tilemap_get_tile_ptr(t, arr[i].x, arr[i].y);
-			if (ptr != NULL && *ptr == Empty && rand() % 2 == 0) {
-				*ptr = Food;
+		int cx = guys->x[index] + cells[i].x;
+		int cy = guys->y[index] + cells[i].y;
+		for (int n = 0; n < 4; n++) {
+			if (!(cell_flips & (2u << n))) {
+				continue;
 			}
-		}
-	} break;
-	case Eater : {
-		TileType *ptr;
-		for(int i = 0; i < 4; i++) {
-			ptr = tilemap_get_tile_ptr(t, arr[i].x, arr[i].y);
-			if (ptr != NULL && *ptr == Food) {
-				guy->food_consumed += 1;
-				*ptr = Empty;
+			int x = cx + neighbour_dx[n];
+			int y = cy + neighbour_dy[n];
+			if (clip && !(0 <= x && 0 <= y && x < t->w && y < t->h)) {
+				continue;
+			}
+			int word = y * t->row_words + x / 64;
+			u64 bit = (u64) 1 << (x % 64);
+			if (!((t->food[word] | t->wall[word]) & bit)) {
+				t->food[word] |= bit;
+				tilemap_mark_dirty(t, x, y);
 			}
 		}
-	} break;
-	default : break;
 	}
 }
 
+// the movers of a guy move it one tile together, the same way for a few
+// moves until it's blocked
 void
-aliveguy_calculate_new_lifetime(AliveGuy *guy) {
-	guy->lifetime = aliveguy_cells_amount(guy) * 80;
+cell_kernel_move(Game *game, int index, BodyCell *cells, int amount, int clip) {
+	AliveGuys *guys = &game->guys;
+	Rng *rng = &guys->rng[index];
+
+	if (guys->moving_frames_left[index] <= 0) {
+		guys->moving_frames_left[index] = 1 + rng_below(rng, 6);
+		guys->moving_direction[index] = rng_below(rng, 4);
+	}
+	int x = guys->x[index] + neighbour_dx[guys->moving_direction[index]];
+	int y = guys->y[index] + neighbour_dy[guys->moving_direction[index]];
+
+	if (aliveguy_is_spot_vacant(aliveguy_genome(game, index), x, y, index, game)) {
+		guys->moving_frames_left[index] -= 1;
+		game_aliveguy_register_move(game, index, x, y);
+	} else {
+		guys->moving_frames_left[index] = 0;
+	}
 }
 
-int
-aliveguy_food_needed_to_reproduce(AliveGuy *guy) {
-	return aliveguy_cells_amount(guy) * 15;
+// an eater eats the food on the tiles next to it
+void
+cell_kernel_eat(Game *game, int index, BodyCell *cells, int amount, int clip) {
+	TileMap *t = game->map;
+	AliveGuys *guys = &game->guys;
+	int eaten = 0;
+	for (int i = 0; i < amount; i++) {
+		int cx = guys->x[index] + cells[i].x;
+		int cy = guys->y[index] + cells[i].y;
+		for (int n = 0; n < 4; n++) {
+			int x = cx + neighbour_dx[n];
+			int y = cy + neighbour_dy[n];
+			if (clip && !(0 <= x && 0 <= y && x < t->w && y < t->h)) {
+				continue;
+			}
+			int word = y * t->row_words + x / 64;
+			u64 bit = (u64) 1 << (x % 64);
+			if (t->food[word] & bit) {
+				eaten += 1;
+				t->food[word] &= ~bit;
+				tilemap_mark_dirty(t, x, y);
+			}
+		}
+	}
+	guys->food_consumed[index] += eaten;
 }
 
-int
-aliveguy_occupies_point(AliveGuy *guy, int x, int y) {
-	// @todo implement boxes
+void
+aliveguy_calculate_new_lifetime(Game *game, int index) {
+	aliveguy_set_lifetime(game, index, aliveguy_genome(game, index)->lifetime);
+}
 
-	// @todo remove if never gets done
+// the guy dies ticks ticks after the current one
+void
+aliveguy_set_lifetime(Game *game, int index, int ticks) {
+	assert(ticks > 0);
+	game_unschedule_death(game, index);
+	game->guys.death_tick[index] = game->tick + ticks;
+	game_schedule_death(game, index);
+}
 
-	if(x < guy->x) {
-		return 0;
+void
+game_schedule_death(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	assert(guys->death_tick[index] != 0);
+	int *head = &game->death_wheel[guys->death_tick[index] % DEATH_WHEEL_SLOTS];
+	guys->wheel_prev[index] = -1;
+	guys->wheel_next[index] = *head;
+	if (*head != -1) {
+		guys->wheel_prev[*head] = index;
 	}
+	*head = index;
+}
 
-	if(y < guy->y) {
-		return 0;
+void
+game_unschedule_death(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	if (guys->death_tick[index] == 0) {
+		return;
 	}
 
-	if(x > guy->x + ALIVEGUY_CELLS_W) {
-		return 0;
+	int next = guys->wheel_next[index];
+	int prev = guys->wheel_prev[index];
+	if (next != -1) {
+		guys->wheel_prev[next] = prev;
 	}
-
-	if(y > guy->y + ALIVEGUY_CELLS_H) {
-		return 0;
+	if (prev != -1) {
+		guys->wheel_next[prev] = next;
+	} else {
+		game->death_wheel[guys->death_tick[index] % DEATH_WHEEL_SLOTS] = next;
 	}
+	guys->death_tick[index] = 0;
+	guys->wheel_next[index] = -1;
+	guys->wheel_prev[index] = -1;
+}
 
-	for (int gy = 0; gy < ALIVEGUY_CELLS_H; gy++) {
-		for (int gx = 0; gx < ALIVEGUY_CELLS_W; gx++) {
-			CellType cell = aliveguy_get_cell(guy, gx, gy);
-			if (cell == None) {
-				continue;
-			}
+int
+compare_ints(const void *a, const void *b) {
+	int x = *(const int *) a;
+	int y = *(const int *) b;
+	return (x > y) - (x < y);
+}
 
-			if (guy->x + gx == x &&
-			    guy->y + gy == y) {
-				return 1;
-			}
+// the guys whose time is up die before anyone moves this tick, in slot
+// order, and all their bodies turn to food together
+void
+game_kill_due(Game *game) {
+	AliveGuys *guys = &game->guys;
+	int amount = 0;
+	int slot = game->tick % DEATH_WHEEL_SLOTS;
+	for (int i = game->death_wheel[slot]; i != -1; i = guys->wheel_next[i]) {
+		if (guys->death_tick[i] != game->tick) {
+			continue;
 		}
+		game->dying[amount] = i;
+		amount += 1;
 	}
+	qsort(game->dying, amount, sizeof(int), compare_ints);
 
-	return 0;
+	for (int j = 0; j < amount; j++) {
+		int i = game->dying[j];
+		game_log_death(game, i);
+		game_aliveguy_register_death(game, i);
+	}
+	for (int j = 0; j < amount; j++) {
+		int i = game->dying[j];
+		tilemap_stamp_food(game->map, guys->x[i], guys->y[i],
+				   aliveguy_body(game, i));
+		game_free_aliveguy(game, i);
+	}
+}
+
+int
+aliveguy_food_needed_to_reproduce(Game *game, int index) {
+	return aliveguy_genome(game, index)->food_needed;
 }
 
 int
 game_is_point_vacant(Game *game, int x, int y) {
 	TileMap *tm = game->map;
+	game_profile(game)->point_vacant_calls += 1;
 	if (!(0 < x && x < tm->w &&
 	      0 < y && y < tm->h)) {
 		return 0;
@@ -391,45 +1344,78 @@ game_is_point_vacant(Game *game, int x, int y) {
 		return 0;
 	}
 
-	// @todo implement boxes
-	for (int i = 0; i < GUYS_N; i++) {
-		AliveGuy *guy = &game->guys[i];
-		if(guy->hp > 0) {
-			if (aliveguy_occupies_point(guy, x, y)) {
-				return 0;
-			}
-		}
+	if (tilemap_get_occupant(tm, x, y) != -1) {
+		return 0;
 	}
 
 	return 1;
 }
 
+// whether body fits with its origin at x, y. cells of the guy with index
+// `ignore` don't count as occupied, so a guy can check a spot overlapping
+// its current one. -1 ignores nobody
 int
-aliveguy_is_spot_vacant(AliveGuy *guy, int x, int y, Game *game) {
+aliveguy_is_spot_vacant(Genome *genome, int x, int y, int ignore, Game *game) {
 	TileMap *tm = game->map;
-	for (int gy = 0; gy < ALIVEGUY_CELLS_H; gy++) {
-		for (int gx = 0; gx < ALIVEGUY_CELLS_W; gx++) {
-			CellType cell = aliveguy_get_cell(guy, gx, gy);
-			if (cell == None) {
-				continue;
-			}
-
-			int nx = x + gx;
-			int ny = y + gy;
+	AliveGuys *guys = &game->guys;
+	Body *body = &genome->body;
+	game_profile(game)->spot_vacant_calls += 1;
+
+	// the bounding box is tight, so it's off the map exactly when one of
+	// the cells is
+	int sx = x + body->start_x;
+	if (!(0 < sx && x + body->end_x < tm->w &&
+	      0 < y + body->start_y && y + body->end_y < tm->h)) {
+		return 0;
+	}
 
-			if (!(0 < nx && nx < tm->w &&
-			      0 < ny && ny < tm->h)) {
-				return 0;
-			}
+	// each row of the body, shifted to start at sx, against the same 16
+	// tiles of the world, which sit in at most two words of each plane.
+	// the tiles ignore sits on don't count as occupied, nobody else can
+	// be on them
+	int word = sx / 64;
+	int shift = sx % 64;
+	int spans = shift > 64 - ALIVEGUY_CELLS_W && word + 1 < tm->row_words;
+	u16 *own_masks = NULL;
+	int own_shift = 0;
+	int own_y = 0;
+	if (ignore != -1) {
+		own_shift = guys->x[ignore] - sx;
+		own_y = guys->y[ignore] - y;
+		if (-ALIVEGUY_CELLS_W < own_shift && own_shift < ALIVEGUY_CELLS_W) {
+			own_masks = aliveguy_genome(game, ignore)->row_masks;
+		}
+	}
 
-			if (tilemap_get_tile(tm, nx, ny) != Empty) {
-				return 0;
-			}
+	for (int by = body->start_y; by <= body->end_y; by++) {
+		u64 mask = genome->row_masks[by] >> body->start_x;
+		int at = (y + by) * tm->row_words + word;
+		u64 taken = tm->food[at] | tm->wall[at] | tm->occupied[at];
+		u64 bits = taken >> shift;
+		if (spans) {
+			taken = tm->food[at + 1] | tm->wall[at + 1] | tm->occupied[at + 1];
+			bits |= taken << (64 - shift);
+		}
+		if (!(bits & mask)) {
+			continue;
+		}
 
-			// @todo implement boxes
-			if (!game_is_point_vacant(game, nx, ny)) {
-				return 0;
-			}
+		// something's there, fine only if it's all ignore's own cells
+		int oy = by - own_y;
+		if (own_masks == NULL || !(0 <= oy && oy < ALIVEGUY_CELLS_H)) {
+			return 0;
+		}
+		u64 own = own_masks[oy];
+		own = own_shift >= 0 ? own << own_shift : own >> -own_shift;
+		if (bits & mask & ~own) {
+			return 0;
+		}
+		u64 tiles = (tm->food[at] | tm->wall[at]) >> shift;
+		if (spans) {
+			tiles |= (tm->food[at + 1] | tm->wall[at + 1]) << (64 - shift);
+		}
+		if (tiles & mask) {
+			return 0;
 		}
 	}
 
@@ -437,161 +1423,118 @@ aliveguy_is_spot_vacant(AliveGuy *guy, int x, int y, Game *game) {
 }
 
 void
-game_aliveguy_register_birth(Game *game, AliveGuy *aliveguy) {
-	// @todo do this
-
-	//int top_lef_x = aliveguy->x;
-	//int top_lef_y = aliveguy->y;
-
-	//int top_rig_x = aliveguy->x + ALIVEGUY_CELLS_W;
-	//int top_rig_y = aliveguy->y;
+game_aliveguy_set_occupants(Game *game, int index, int occupant) {
+	AliveGuys *guys = &game->guys;
+	BodyIter it;
+	BodyCell bc;
+	body_iter_init(&it, aliveguy_body(game, index));
+	while (body_iter_next(&it, &bc)) {
+		tilemap_set_occupant(game->map,
+				     guys->x[index] + bc.x, guys->y[index] + bc.y,
+				     occupant);
+	}
+}
 
-	//int bot_lef_x = aliveguy->x;
-	//int bot_lef_y = aliveguy->y + ALIVEGUY_CELLS_H;
+void
+game_aliveguy_register_birth(Game *game, int index) {
+	assert(game->guys.rect_index[index] == -1);
 
-	//int bot_rig_x = aliveguy->x + ALIVEGUY_CELLS_W;
-	//int bot_rig_y = aliveguy->y + ALIVEGUY_CELLS_H;
-	
+	game_aliveguy_set_occupants(game, index, index);
+	game->guys.rect_index[index] = game_aliveguy_rect_index(game, index);
 }
 
-// game is passed in order to check if the added cell is occupied
 void
-aliveguy_guy_mutate(AliveGuy *guy, Game *game) {
-	enum {
-		AddCell,
-		ChangeCell,
-		RemoveCell,
-		Choices
-	} choice;
-	choice = rand() % Choices;
+game_aliveguy_register_death(Game *game, int index) {
+	assert(game->guys.rect_index[index] != -1);
 
-	struct pt { int x; int y; };
-	#define NEI_CELLS_N ALIVEGUY_CELLS_W * ALIVEGUY_CELLS_H
-	struct pt neighboring_cells[NEI_CELLS_N];
-	int nc_amount = 0;
+	game_aliveguy_set_occupants(game, index, -1);
+	game->guys.rect_index[index] = -1;
+}
 
-	TileMap *tm = game->map;
+void
+game_aliveguy_register_move(Game *game, int index, int x, int y) {
+	assert(game->guys.rect_index[index] != -1);
+
+	game_aliveguy_set_occupants(game, index, -1);
+	game->guys.x[index] = x;
+	game->guys.y[index] = y;
+	game_aliveguy_set_occupants(game, index, index);
+	game->guys.rect_index[index] = game_aliveguy_rect_index(game, index);
+}
 
-	// get neighboring cells
-	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell;
-			cell = aliveguy_get_cell(guy, x, y);
-			if (cell == None) {
-				continue;
+// changes body, a copy of genome's, for the guy where it is. game is
+// passed in order to check if the added cell is occupied
+void
+aliveguy_guy_mutate(Game *game, int index, Genome *genome, Body *body) {
+	AliveGuys *guys = &game->guys;
+	Rng *rng = &guys->rng[index];
+	int gx = guys->x[index];
+	int gy = guys->y[index];
+
+	Mutation choice;
+	choice = rng_below(rng, MutationsN);
+
+	// a cell is only added if the tile it'd go on is free, the other
+	// candidates are never looked at
+	if (choice == AddCell && genome->frontier_amount > 0) {
+		int pick = rng_below(rng, genome->frontier_amount);
+		int bx = 0;
+		int by = 0;
+		for (by = 1; by < ALIVEGUY_CELLS_H; by++) {
+			int in_row = __builtin_popcount(genome->frontier[by]);
+			if (pick < in_row) {
+				u32 left = genome->frontier[by];
+				for (; pick > 0; pick--) {
+					left &= left - 1;
+				}
+				bx = __builtin_ctz(left);
+				break;
 			}
+			pick -= in_row;
+		}
+		assert(by < ALIVEGUY_CELLS_H);
 
-			int out;
-
-			// @todo refactor this into function
-#define ADD_IF_NOT_THERE(bx, by)					\
-			if (!(0 < guy->x + bx && guy->x + bx < tm->w && \
-			      0 < guy->y + by && guy->y + by < tm->h)) { \
-				out = 1;				\
-			}						\
-			if (!(0 < bx && bx < tm->w &&			\
-			      0 < by && by < tm->h)) {			\
-				out = 1;				\
-			}						\
-			if (!out) {					\
-				int cond1 = game_is_point_vacant(	\
-					game, guy->x + bx, guy->y + by); \
-				int cond2 =				\
-					aliveguy_get_cell(guy, bx, by) == None; \
-				if (cond1 && cond2) {			\
-					neighboring_cells[nc_amount].x = bx; \
-					neighboring_cells[nc_amount].y = by; \
-					nc_amount += 1;			\
-					assert(nc_amount < NEI_CELLS_N); \
-				}					\
-			}						\
-			out = 0;					\
-
-			ADD_IF_NOT_THERE((x - 1), (y - 1));
-			ADD_IF_NOT_THERE((x    ), (y - 1));
-			ADD_IF_NOT_THERE((x + 1), (y - 1));
-			ADD_IF_NOT_THERE((x - 1), (y    ));
-			ADD_IF_NOT_THERE((x + 1), (y    ));
-			ADD_IF_NOT_THERE((x - 1), (y + 1));
-			ADD_IF_NOT_THERE((x    ), (y + 1));
-			ADD_IF_NOT_THERE((x + 1), (y + 1));
-
-			#undef ADD_IF_NOT_THERE
-		}
-	}
-
-	if (nc_amount == 0) {
-		goto END_OF_CHANGES;
-	}
-
-	if (choice == AddCell) {
-		int index = rand() % nc_amount;
-		struct pt randcellpos = neighboring_cells[index];
 		CellType ct;
-		ct = rand() % CellTypesN;
-		aliveguy_set_cell(guy, randcellpos.x, randcellpos.y, ct);
+		ct = rng_below(rng, CellTypesN);
+		if (ct != None && game_is_point_vacant(game, gx + bx, gy + by)) {
+			body_set_cell(body, bx, by, ct);
+			game_log_mutation(game, index, AddCell, bx, by, None, ct);
+		}
 	}
 
 	if (choice == RemoveCell) {
-		int amount = aliveguy_cells_amount(guy);
+		int amount = body->cells_amount;
 		if (amount == 1) {
 			goto OUT_OF_REMOVE_CELL;
 		}
 
-		int chosen_cell = rand() % amount;
-		int acc = 0;
-
-		for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-			for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-				CellType cell;
-				cell = aliveguy_get_cell(guy, x, y);
-				if (cell == None) {
-					continue;
-				}
-
-				if (chosen_cell == acc) {
-					aliveguy_set_cell(guy, x, y, Empty);
-					goto OUT_OF_REMOVE_CELL;
-				}
-				acc++;
-			}
-		}
+		BodyCell chosen = body_nth_cell(body, rng_below(rng, amount));
+		body_set_cell(body, chosen.x, chosen.y, None);
+		game_log_mutation(game, index, RemoveCell,
+				  chosen.x, chosen.y, chosen.type, None);
 	}
 OUT_OF_REMOVE_CELL:
 	if (choice == ChangeCell) {
-		int amount = aliveguy_cells_amount(guy);
-		int chosen_cell = rand() % amount;
-		int acc = 0;
+		int amount = body->cells_amount;
+		int chosen_cell = rng_below(rng, amount);
 
 		CellType ct;
-		ct = rand() % CellTypesN;
+		ct = rng_below(rng, CellTypesN);
 
 		if (ct == None) {
 			goto OUT_OF_CHANGE_CELL;
 		}
 
-		for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-			for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-				CellType cell;
-				cell = aliveguy_get_cell(guy, x, y);
-				if (cell == None) {
-					continue;
-				}
-
-				if (chosen_cell == acc) {
-					aliveguy_set_cell(guy, x, y, ct);
-					goto OUT_OF_CHANGE_CELL;
-				}
-
-				acc++;
-			}
+		BodyCell chosen = body_nth_cell(body, chosen_cell);
+		body_set_cell(body, chosen.x, chosen.y, ct);
+		if (chosen.type != ct) {
+			game_log_mutation(game, index, ChangeCell,
+					  chosen.x, chosen.y, chosen.type, ct);
 		}
 	}
 OUT_OF_CHANGE_CELL:
-END_OF_CHANGES:
 
-	if(aliveguy_cells_amount(guy) < 1) {
-		aliveguy_tostring(guy);
+	if(body->cells_amount < 1) {
 		printf("ZERO CELLS IN MUTATION \\o/\n");
 		abort();
 	}
@@ -600,64 +1543,79 @@ END_OF_CHANGES:
 }
 
 void
-aliveguy_birth(AliveGuy *guy, int x, int y, Game *game) {
-	AliveGuy *child = game_new_aliveguy(game);
-	
-	if (child == NULL) {
+aliveguy_birth(Game *game, int parent, int x, int y) {
+	int child = game_new_aliveguy(game);
+
+	if (child == -1) {
 		// couldnt give birth :(
 		return;
 	}
 
-	aliveguy_init(child);
-
-	child->hp = 50;
-	child->food_consumed = 0;
-
-	child->x = x;
-	child->y = y;
-
-	assert(aliveguy_cells_amount(guy) > 0);
-	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
-			aliveguy_set_cell(child, x, y, cell);
-		}
-	}
-
-	if(rand() % 100 < game->mutation_chance_percent) {
-		aliveguy_guy_mutate(guy, game);
+	AliveGuys *guys = &game->guys;
+	aliveguy_init(game, child);
+
+	// the child's stream is split off the parent's
+	u64 child_seed = rng_next(&guys->rng[parent]);
+	child_seed = (child_seed << 32) | rng_next(&guys->rng[parent]);
+	rng_seed(&guys->rng[child], child_seed);
+
+	guys->hp[child] = 50;
+	guys->food_consumed[child] = 0;
+
+	guys->x[child] = x;
+	guys->y[child] = y;
+
+	// the child shares the parent's genome unless it mutates
+	assert(aliveguy_body(game, parent)->cells_amount > 0);
+	if(rng_below(&guys->rng[child], 100) < game->mutation_chance_percent) {
+		Body body = *aliveguy_body(game, parent);
+		u64 start = profile_start(game);
+		aliveguy_guy_mutate(game, child, aliveguy_genome(game, parent), &body);
+		profile_stop(game, PhaseMutate, start);
+		guys->genome[child] = genome_intern(&game->genomes, &body, game->tick);
+	} else {
+		guys->genome[child] = guys->genome[parent];
+		genome_acquire(&game->genomes, guys->genome[child]);
 	}
-	assert(aliveguy_cells_amount(child) > 0);
+	assert(aliveguy_body(game, child)->cells_amount > 0);
 
-	aliveguy_calculate_new_lifetime(child);
+	aliveguy_calculate_new_lifetime(game, child);
 
-	game_aliveguy_register_birth(game, guy);
+	game_aliveguy_register_birth(game, child);
+	game_log_birth(game, child, parent);
 }
 
 int
-aliveguy_try_reproduce(AliveGuy *guy, int index, Game *game) {
+aliveguy_try_reproduce(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	Genome *genome = aliveguy_genome(game, index);
+	Body *body = &genome->body;
+	int gx = guys->x[index];
+	int gy = guys->y[index];
+
 	// find vacant_spot
-	assert(aliveguy_cells_amount(guy) > 0);
+	assert(body->cells_amount > 0);
+	u64 start = profile_start(game);
 
-	int sx = aliveguy_starting_x(guy);
-	int sy = aliveguy_starting_y(guy);
-	int ex = aliveguy_ending_x(guy);
-	int ey = aliveguy_ending_y(guy);
+	int sx = body->start_x;
+	int sy = body->start_y;
+	int ex = body->end_x;
+	int ey = body->end_y;
 
 	int offset_x = ex - sx + (4 /*+ (rand() % 5)*/);
 	int offset_y = ey - sy + (4 /*+ (rand() % 5)*/);
 
 	struct pt { int x; int y; };
 	struct pt arr[4] = {
-		{guy->x - offset_x, guy->y           },
-		{guy->x + offset_x, guy->y           },
-		{guy->x           , guy->y - offset_y},
-		{guy->x           , guy->y + offset_y}
+		{gx - offset_x, gy           },
+		{gx + offset_x, gy           },
+		{gx           , gy - offset_y},
+		{gx           , gy + offset_y}
 	};
 
 	// randomize the array
 	for(int i = 0; i < 4; i++) {
-		int rn = rand() % 4;
+		int rn = rng_below(&guys->rng[index], 4);
 		if (rn == i) { continue; }
 		struct pt tmp = arr[i];
 		arr[i] = arr[rn];
@@ -666,26 +1624,29 @@ aliveguy_try_reproduce(AliveGuy *guy, int index, Game *game) {
 
 	for(int i = 0; i < 4; i++) {
 		int x = arr[i].x, y = arr[i].y;
-		if(aliveguy_is_spot_vacant(guy, x, y, game)) {
-			aliveguy_birth(guy, x, y, game);
+		if(aliveguy_is_spot_vacant(genome, x, y, -1, game)) {
+			profile_stop(game, PhaseReproduce, start);
+			game->births[index] = (BirthRequest) { index, x, y };
 			return 1;
 		}
 	}
 
+	profile_stop(game, PhaseReproduce, start);
 	return 0;
 }
 
 void
-aliveguy_tostring(AliveGuy *guy) {
-	printf("x %d:\n", guy->x);
-	printf("y %d:\n", guy->y);
-	printf("lifetime %d:\n", guy->lifetime);
-	printf("hp %d:\n", guy->hp);
-	printf("foodconsumed %d:\n", guy->food_consumed);
+aliveguy_tostring(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	printf("x %d:\n", guys->x[index]);
+	printf("y %d:\n", guys->y[index]);
+	printf("death tick %llu:\n", (unsigned long long) guys->death_tick[index]);
+	printf("hp %d:\n", guys->hp[index]);
+	printf("foodconsumed %d:\n", guys->food_consumed[index]);
 	printf("cells:\n");
 	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
 		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			switch(aliveguy_get_cell(guy, x, y)) {
+			switch(body_get_cell(aliveguy_body(game, index), x, y)) {
 			case None     : printf("."); break;
 			case Producer : printf("P"); break;
 			case Mover    : printf("M"); break;
@@ -699,150 +1660,319 @@ aliveguy_tostring(AliveGuy *guy) {
 	printf("\n");
 }
 
+// whether the ring of tiles around the guy's bounding box leaves the map
+int
+aliveguy_clips(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	Body *body = aliveguy_body(game, index);
+	TileMap *t = game->map;
+	int x = guys->x[index];
+	int y = guys->y[index];
+	return !(0 < x + body->start_x && x + body->end_x < t->w - 1 &&
+		 0 < y + body->start_y && y + body->end_y < t->h - 1);
+}
+
 void
-aliveguy_update(AliveGuy *guy, int index, Game *game) {
-	if (guy->hp <= 0) {
+aliveguy_update(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	Genome *genome = aliveguy_genome(game, index);
+	Body *body = &genome->body;
+
+	if (guys->hp[index] <= 0) {
 		return;
 	}
 
-	if(aliveguy_cells_amount(guy) < 1) {
-		aliveguy_tostring(guy);
+	if(body->cells_amount < 1) {
+		aliveguy_tostring(game, index);
 		printf("wtf\n");
 		abort();
 	}
 
-	guy->lifetime -= 1;
-
-	if (guy->lifetime == 0) {
-		printf("organism %d died of old age.\n", index);
-		guy->hp = 0;
-
-		for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-			for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-				CellType cell = aliveguy_get_cell(guy, x, y);
-				if (cell == None) {
-					continue;
-				}
-
-				int nx = x + guy->x;
-				int ny = y + guy->y;
-
-				tilemap_set_tile(game->map, nx, ny, Food);
-			}
-		}
-	}
-
-	if (guy->hp <= 0) {
-		return;
-	}
-
-	int food_needed = aliveguy_food_needed_to_reproduce(guy);
+	int food_needed = aliveguy_food_needed_to_reproduce(game, index);
 	
-	if (guy->food_consumed > food_needed) {
-		int success = aliveguy_try_reproduce(guy, index, game);
+	if (guys->food_consumed[index] > food_needed) {
+		int success = aliveguy_try_reproduce(game, index);
 		(void) success;
 		//if (success) {
-		guy->food_consumed -= food_needed;
+		guys->food_consumed[index] -= food_needed;
 		//}
 	}
 
 
-	struct pt { int x; int y; };
-	struct pt arr[4] = {
-		{guy->x - 1, guy->y    },
-		{guy->x + 1, guy->y    },
-		{guy->x    , guy->y - 1},
-		{guy->x    , guy->y + 1}
-	};
-	struct pt direction;
-
-	if (guy->moving_frames_left <= 0) {
-		guy->moving_frames_left = 1 + (rand() % 6);
-		guy->moving_direction = rand() % 4;
-	}
-	direction = arr[guy->moving_direction];
-
-	int has_moved = 0;
-	int has_mover = 0;
-	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
-			if (cell == Mover) {
-				has_mover = 1;
-				goto OUT_OF_MOVER_LOOP;
-			}
+	for (int type = 0; type < CellTypesN; type++) {
+		int start = genome->type_start[type];
+		int amount = genome_cells_of(genome, type);
+		if (amount == 0) {
+			continue;
 		}
-	}
-OUT_OF_MOVER_LOOP:
 
-	for (int y = 0; y < ALIVEGUY_CELLS_H; y++) {
-		for (int x = 0; x < ALIVEGUY_CELLS_W; x++) {
-			CellType cell = aliveguy_get_cell(guy, x, y);
-			if (cell == None) {
-				continue;
-			}
-			if (cell == Producer && has_mover) {
-				continue;
-			}
-			if (cell == Mover && !has_moved) {
-				has_moved = 1;
-
-				// the hp is set to 0 in order to
-				// not count its own spots as non-vacant
-				// in the function aliveguy_is_spot_vacant
-				int old_hp = guy->hp;
-				guy->hp = 0;
-				int vacant = aliveguy_is_spot_vacant(
-					guy, direction.x, direction.y, game);
-				if (vacant) {
-					guy->moving_frames_left -= 1;
-					guy->x = direction.x;
-					guy->y = direction.y;
-				} else {
-					guy->moving_frames_left = 0;
-				}
-				guy->hp = old_hp;
-			}
-			cell_update(cell, x, y, guy, index, game);
-		}
+		const CellKernelEntry *kernel = &cell_kernels[type];
+		assert(kernel->run != NULL);
+		u64 kernel_start = profile_start(game);
+		kernel->run(game, index, &genome->cells[start], amount,
+			    aliveguy_clips(game, index));
+		profile_stop(game, kernel->phase, kernel_start);
 	}
 }
 
+// words in a row of a plane of a map w tiles wide
+int
+tilemap_row_words(int w) {
+	int line_words = TILEMAP_ROW_ALIGN / sizeof(u64);
+	return ((w + 63) / 64 + line_words - 1) / line_words * line_words;
+}
+
 TileMap *
 make_tilemap(int w, int h) {
 	TileMap *ret = malloc(sizeof(TileMap));
-	ret->tiles = malloc(sizeof(TileType) * w * h);
+
+	ret->row_words = tilemap_row_words(w);
+	size_t plane_size = sizeof(u64) * ret->row_words * h;
+	ret->food = aligned_alloc(TILEMAP_ROW_ALIGN, plane_size);
+	ret->wall = aligned_alloc(TILEMAP_ROW_ALIGN, plane_size);
+	ret->occupied = aligned_alloc(TILEMAP_ROW_ALIGN, plane_size);
+	assert(ret->food != NULL && ret->wall != NULL && ret->occupied != NULL);
+	memset(ret->food, 0, plane_size);
+	memset(ret->wall, 0, plane_size);
+	memset(ret->occupied, 0, plane_size);
+
 	ret->w = w;
 	ret->h = h;
-	for (int i = 0; i < w * h; i++) {
-		ret->tiles[i] = Empty;
+
+	ret->chunks_w = (w + TILEMAP_CHUNK - 1) / TILEMAP_CHUNK;
+	ret->chunks_h = (h + TILEMAP_CHUNK - 1) / TILEMAP_CHUNK;
+	ret->chunks = malloc(sizeof(TileChunk) * ret->chunks_w * ret->chunks_h);
+	for (int i = 0; i < ret->chunks_w * ret->chunks_h; i++) {
+		ret->chunks[i].occupants = NULL;
+		ret->chunks[i].occupants_amount = 0;
+		ret->chunks[i].dirty = NULL;
+		ret->chunks[i].is_dirty = false;
 	}
 
 	return ret;
 }
 
-TileType *
-tilemap_get_tile_ptr(TileMap *map, int x, int y) {
-	if (!(0 <= x && 0 <= y &&
-	      x < map->w && y < map->h)) {
-		return NULL;
-	}
+TileChunk *
+tilemap_get_chunk(TileMap *map, int x, int y) {
+	return &map->chunks[(y / TILEMAP_CHUNK) * map->chunks_w + x / TILEMAP_CHUNK];
+}
 
-	return &map->tiles[y * map->w + x];
+void
+tilemap_mark_dirty(TileMap *map, int x, int y) {
+#ifndef HEADLESS
+	TileChunk *chunk = tilemap_get_chunk(map, x, y);
+	if (chunk->dirty == NULL) {
+		chunk->dirty = malloc(sizeof(u64) * TILEMAP_CHUNK);
+		memset(chunk->dirty, 0, sizeof(u64) * TILEMAP_CHUNK);
+	}
+	chunk->dirty[y % TILEMAP_CHUNK] |= (u64) 1 << (x % TILEMAP_CHUNK);
+	chunk->is_dirty = true;
+#endif
 }
 
 TileType
 tilemap_get_tile(TileMap *map, int x, int y) {
 	assert(0 <= x && 0 <= y);
 	assert(x < map->w && y < map->h);
-	return map->tiles[y * map->w + x];
+	int word = y * map->row_words + x / 64;
+	u64 bit = (u64) 1 << (x % 64);
+	if (map->food[word] & bit) {
+		return Food;
+	}
+	if (map->wall[word] & bit) {
+		return Wall;
+	}
+	return Empty;
 }
 
 void
 tilemap_set_tile(TileMap *map, int x, int y, TileType t) {
 	assert(0 <= x && 0 <= y);
 	assert(x < map->w && y < map->h);
-	map->tiles[y * map->w + x] = t;
+	int word = y * map->row_words + x / 64;
+	u64 bit = (u64) 1 << (x % 64);
+	map->food[word] &= ~bit;
+	map->wall[word] &= ~bit;
+	if (t == Food) {
+		map->food[word] |= bit;
+	} else if (t == Wall) {
+		map->wall[word] |= bit;
+	}
+	tilemap_mark_dirty(map, x, y);
+}
+
+// the bits of the word-th word of a row that hold tiles x0 <= x < x1
+u64
+tilemap_word_mask(int word, int x0, int x1) {
+	int lo = x0 - word * 64;
+	int hi = x1 - word * 64;
+	u64 mask = ~(u64) 0;
+	if (lo > 0) {
+		mask &= ~(u64) 0 << lo;
+	}
+	if (hi < 64) {
+		mask &= ((u64) 1 << hi) - 1;
+	}
+	return mask;
+}
+
+// the region is clipped to the map, as are the ones below
+long
+tilemap_count_food(TileMap *map, int x, int y, int w, int h) {
+	int x0 = x < 0 ? 0 : x;
+	int y0 = y < 0 ? 0 : y;
+	int x1 = x + w > map->w ? map->w : x + w;
+	int y1 = y + h > map->h ? map->h : y + h;
+	if (x0 >= x1 || y0 >= y1) {
+		return 0;
+	}
+
+	int first = x0 / 64;
+	int last = (x1 - 1) / 64;
+	u64 first_mask = tilemap_word_mask(first, x0, x1);
+	u64 last_mask = tilemap_word_mask(last, x0, x1);
+
+	long count = 0;
+	for (int ty = y0; ty < y1; ty++) {
+		u64 *row = __builtin_assume_aligned(
+			&map->food[ty * map->row_words], TILEMAP_ROW_ALIGN);
+		if (first == last) {
+			count += __builtin_popcountll(row[first] & first_mask);
+			continue;
+		}
+
+		count += __builtin_popcountll(row[first] & first_mask);
+		for (int i = first + 1; i < last; i++) {
+			count += __builtin_popcountll(row[i]);
+		}
+		count += __builtin_popcountll(row[last] & last_mask);
+	}
+
+	return count;
+}
+
+// sets every tile of the region to t, a whole word at a time
+void
+tilemap_fill_region(TileMap *map, int x, int y, int w, int h, TileType t) {
+	int x0 = x < 0 ? 0 : x;
+	int y0 = y < 0 ? 0 : y;
+	int x1 = x + w > map->w ? map->w : x + w;
+	int y1 = y + h > map->h ? map->h : y + h;
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	int first = x0 / 64;
+	int last = (x1 - 1) / 64;
+	for (int ty = y0; ty < y1; ty++) {
+		u64 *food = __builtin_assume_aligned(
+			&map->food[ty * map->row_words], TILEMAP_ROW_ALIGN);
+		u64 *wall = __builtin_assume_aligned(
+			&map->wall[ty * map->row_words], TILEMAP_ROW_ALIGN);
+		for (int i = first; i <= last; i++) {
+			u64 mask = tilemap_word_mask(i, x0, x1);
+			u64 food_bits = t == Food ? mask : 0;
+			u64 wall_bits = t == Wall ? mask : 0;
+			food[i] = (food[i] & ~mask) | food_bits;
+			wall[i] = (wall[i] & ~mask) | wall_bits;
+		}
+	}
+
+#ifndef HEADLESS
+	for (int ty = y0; ty < y1; ty++) {
+		for (int tx = x0; tx < x1; tx++) {
+			tilemap_mark_dirty(map, tx, ty);
+		}
+	}
+#endif
+}
+
+// turns the tiles under body, placed at x, y, into food a row at a time.
+// they have to be on the map and not walls. x can be negative as long as
+// the body's empty columns are the ones hanging off the map
+void
+tilemap_stamp_food(TileMap *map, int x, int y, Body *body) {
+	for (int by = body->start_y; by <= body->end_y; by++) {
+		u64 mask = body_row_mask(body->rows[by]);
+		if (mask == 0) {
+			continue;
+		}
+
+		int tx = x;
+		if (tx < 0) {
+			assert((mask & (((u64) 1 << -tx) - 1)) == 0);
+			mask >>= -tx;
+			tx = 0;
+		}
+
+		int ty = y + by;
+		assert(0 <= ty && ty < map->h);
+		int word = ty * map->row_words + tx / 64;
+		int shift = tx % 64;
+		map->food[word] |= mask << shift;
+		// only touch the next word when cells spill into it, it may be
+		// the next row's or past the end of the plane
+		if (shift > 64 - ALIVEGUY_CELLS_W) {
+			u64 spill = mask >> (64 - shift);
+			if (spill != 0 && tx / 64 + 1 < map->row_words) {
+				map->food[word + 1] |= spill;
+			}
+		}
+
+#ifndef HEADLESS
+		for (u64 left = mask; left != 0; left &= left - 1) {
+			tilemap_mark_dirty(map, tx + __builtin_ctzll(left), ty);
+		}
+#endif
+	}
+}
+
+int
+tilemap_get_occupant(TileMap *map, int x, int y) {
+	assert(0 <= x && 0 <= y);
+	assert(x < map->w && y < map->h);
+	TileChunk *chunk = tilemap_get_chunk(map, x, y);
+	if (chunk->occupants == NULL) {
+		return -1;
+	}
+	return chunk->occupants[(y % TILEMAP_CHUNK) * TILEMAP_CHUNK + x % TILEMAP_CHUNK];
+}
+
+void
+tilemap_set_occupant(TileMap *map, int x, int y, int occupant) {
+	assert(0 <= x && 0 <= y);
+	assert(x < map->w && y < map->h);
+	TileChunk *chunk = tilemap_get_chunk(map, x, y);
+	if (chunk->occupants == NULL) {
+		// nobody in the chunk, so nobody to take off this tile
+		assert(occupant != -1);
+		chunk->occupants = malloc(sizeof(int) * TILEMAP_CHUNK * TILEMAP_CHUNK);
+		// every byte 0xff makes every int -1
+		memset(chunk->occupants, 0xff, sizeof(int) * TILEMAP_CHUNK * TILEMAP_CHUNK);
+	}
+	int *tile = &chunk->occupants[(y % TILEMAP_CHUNK) * TILEMAP_CHUNK + x % TILEMAP_CHUNK];
+	chunk->occupants_amount += (occupant != -1) - (*tile != -1);
+	*tile = occupant;
+	int word = y * map->row_words + x / 64;
+	u64 bit = (u64) 1 << (x % 64);
+	if (occupant == -1) {
+		map->occupied[word] &= ~bit;
+	} else {
+		map->occupied[word] |= bit;
+	}
+	tilemap_mark_dirty(map, x, y);
+}
+
+// only called between ticks, when no worker is touching the chunks
+void
+tilemap_free_empty_chunks(TileMap *map) {
+	for (int i = 0; i < map->chunks_w * map->chunks_h; i++) {
+		TileChunk *chunk = &map->chunks[i];
+		if (chunk->occupants != NULL && chunk->occupants_amount == 0) {
+			free(chunk->occupants);
+			chunk->occupants = NULL;
+		}
+	}
 }
 
 u32
@@ -856,141 +1986,1680 @@ get_tile_color(TileType t) {
 	assert(0);
 }
 
+#ifndef HEADLESS
+// the cell sitting on the tile if there is one, otherwise the tile itself,
+// lighter on every other rect so the rect grid shows
+u32
+game_get_tile_render_color(Game *game, int x, int y) {
+	TileMap *map = game->map;
+
+	int occupant = tilemap_get_occupant(map, x, y);
+	if (occupant != -1) {
+		AliveGuys *guys = &game->guys;
+		return get_cell_color(body_get_cell(aliveguy_body(game, occupant),
+						    x - guys->x[occupant],
+						    y - guys->y[occupant]));
+	}
+
+	TileType tile = tilemap_get_tile(map, x, y);
+	u32 color = get_tile_color(tile);
+
+	if (y % (RECT_WITH_GUYS_H * 2) < RECT_WITH_GUYS_H) {
+		if (x % (RECT_WITH_GUYS_W * 2) < RECT_WITH_GUYS_W) {
+			color += 0x0a0a0a00;
+		}
+	} else {
+		if (x % (RECT_WITH_GUYS_W * 2) >= RECT_WITH_GUYS_W) {
+			color += 0x0a0a0a00;
+		}
+	}
+
+	return color;
+}
+
+// repaints the tiles marked dirty since the last frame and uploads each
+// chunk that has any, whole
 void
-tilemap_render(TileMap *map) {
-	for (int y = 0; y < map->h; y++) {
-		for (int x = 0; x < map->w; x++) {
-			TileType tile = tilemap_get_tile(map, x, y);
-			u32 color = get_tile_color(tile);
+tilemap_render(Game *game) {
+	TileMap *map = game->map;
+
+	if (map_texture == NULL) {
+		map_texture = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888,
+						SDL_TEXTUREACCESS_STREAMING,
+						map->w, map->h);
+		assert(map_texture != NULL);
+		SDL_SetTextureScaleMode(map_texture, SDL_SCALEMODE_NEAREST);
+		SDL_SetTextureBlendMode(map_texture, SDL_BLENDMODE_NONE);
+
+		map_pixels = malloc(sizeof(u32) * map->w * map->h);
+
+		// the first frame paints everything
+		for (int y = 0; y < map->h; y++) {
+			for (int x = 0; x < map->w; x++) {
+				map_pixels[y * map->w + x] =
+					game_get_tile_render_color(game, x, y);
+			}
+		}
+		SDL_UpdateTexture(map_texture, NULL, map_pixels,
+				  sizeof(u32) * map->w);
+
+		for (int i = 0; i < map->chunks_w * map->chunks_h; i++) {
+			TileChunk *chunk = &map->chunks[i];
+			if (chunk->is_dirty) {
+				memset(chunk->dirty, 0, sizeof(u64) * TILEMAP_CHUNK);
+				chunk->is_dirty = false;
+			}
+		}
+		return;
+	}
 
-			if (y % (RECT_WITH_GUYS_H * 2) < RECT_WITH_GUYS_H) {
-				if (x % (RECT_WITH_GUYS_W * 2) < RECT_WITH_GUYS_W) {
-					color += 0x0a0a0a00;
-				}
-			} else {
-				if (x % (RECT_WITH_GUYS_W * 2) >= RECT_WITH_GUYS_W) {
-					color += 0x0a0a0a00;
-				}
+	// chunks nothing happened in since the last frame are skipped
+	for (int i = 0; i < map->chunks_w * map->chunks_h; i++) {
+		TileChunk *chunk = &map->chunks[i];
+		if (!chunk->is_dirty) {
+			continue;
+		}
+		chunk->is_dirty = false;
+
+		SDL_Rect rect = {
+			(i % map->chunks_w) * TILEMAP_CHUNK,
+			(i / map->chunks_w) * TILEMAP_CHUNK,
+			TILEMAP_CHUNK,
+			TILEMAP_CHUNK
+		};
+		if (rect.x + rect.w > map->w) { rect.w = map->w - rect.x; }
+		if (rect.y + rect.h > map->h) { rect.h = map->h - rect.y; }
+
+		for (int y = 0; y < rect.h; y++) {
+			for (u64 left = chunk->dirty[y]; left != 0; left &= left - 1) {
+				int tx = rect.x + __builtin_ctzll(left);
+				int ty = rect.y + y;
+				map_pixels[ty * map->w + tx] =
+					game_get_tile_render_color(game, tx, ty);
 			}
+			chunk->dirty[y] = 0;
+		}
 
-			sdl_set_color(color);
+		SDL_UpdateTexture(map_texture, &rect,
+				  &map_pixels[rect.y * map->w + rect.x],
+				  sizeof(u32) * map->w);
+	}
+}
 
-			SDL_FRect rect = {
-				x * 10,
-				y * 10,
-				10 - 1,
-				10 - 1
-			};
-			SDL_RenderFillRect(ren, &rect);
-		}
+// drops the texture, the next tilemap_render makes one for whatever map
+// it gets and paints all of it
+void
+tilemap_render_reset(void) {
+	if (map_texture == NULL) {
+		return;
 	}
+
+	SDL_DestroyTexture(map_texture);
+	free(map_pixels);
+	map_texture = NULL;
+	map_pixels = NULL;
 }
+#endif
 
 void
-game_init(Game *game) {
-	game->alives = 0;
+game_alloc(Game *game, int w, int h, int capacity) {
 	game->mutation_chance_percent = 20;
-	for (int i = 0; i < GUYS_N; i++) {
-		aliveguy_init(&game->guys[i]);
+	game->tick = 0;
+	game->log = NULL;
+	genome_table_init(&game->genomes);
+	game->workers = NULL;
+	game->profiling = false;
+	profile_reset(&game->profile);
+
+	AliveGuys *guys = &game->guys;
+	guys->capacity = capacity;
+	guys->x = malloc(sizeof(int) * capacity);
+	guys->y = malloc(sizeof(int) * capacity);
+	guys->death_tick = malloc(sizeof(u64) * capacity);
+	guys->wheel_next = malloc(sizeof(int) * capacity);
+	guys->wheel_prev = malloc(sizeof(int) * capacity);
+	guys->hp = malloc(sizeof(int) * capacity);
+	guys->food_consumed = malloc(sizeof(int) * capacity);
+	guys->moving_direction = malloc(sizeof(u8) * capacity);
+	guys->moving_frames_left = malloc(sizeof(u8) * capacity);
+	guys->rect_index = malloc(sizeof(int) * capacity);
+	guys->rng = malloc(sizeof(Rng) * capacity);
+	guys->genome = malloc(sizeof(int) * capacity);
+	guys->free_slots = malloc(sizeof(int) * capacity);
+	guys->alive_slots = malloc(sizeof(int) * capacity);
+	guys->alive_slots_pos = malloc(sizeof(int) * capacity);
+	game->births = malloc(sizeof(BirthRequest) * capacity);
+	for (int i = 0; i < capacity; i++) {
+		game->births[i].parent = -1;
+	}
+	game->dying = malloc(sizeof(int) * capacity);
+	game->death_wheel = malloc(sizeof(int) * DEATH_WHEEL_SLOTS);
+	for (int i = 0; i < DEATH_WHEEL_SLOTS; i++) {
+		game->death_wheel[i] = -1;
+	}
+	guys->alives = 0;
+	guys->free_amount = 0;
+	// pushed backwards so the lowest slots get used first
+	for (int i = capacity - 1; i >= 0; i--) {
+		aliveguy_init(game, i);
+		guys->alive_slots_pos[i] = -1;
+		guys->free_slots[guys->free_amount] = i;
+		guys->free_amount += 1;
 	}
 
-	game->map = make_tilemap(RECT_WITH_GUYS_W * 10, RECT_WITH_GUYS_H * 10);
-	game->rects_with_guys = malloc(sizeof(RectWithGuys) * 10 * 10);
+	assert(w >= MAP_MIN_SIZE && h >= MAP_MIN_SIZE);
+	game->map = make_tilemap(w, h);
+}
+
+void
+game_init(Game *game, u64 seed, int w, int h, int capacity) {
+	game_alloc(game, w, h, capacity);
+
+	AliveGuys *guys = &game->guys;
+	int g = game_new_aliveguy(game);
+	assert(g != -1);
+	rng_seed(&guys->rng[g], seed);
+	guys->x[g] = 50;
+	guys->y[g] = 0;
+	Body body;
+	body_init(&body);
+	body_set_cell(&body, 5, 5, Producer);
+	body_set_cell(&body, 6, 6, Eater);
+	guys->genome[g] = genome_intern(&game->genomes, &body, game->tick);
+	guys->hp[g] = 50;
+	aliveguy_calculate_new_lifetime(game, g);
+	game_aliveguy_register_birth(game, g);
+}
 
-	int rwgw = game_get_rects_with_guys_w(game);
-	int rwgh = game_get_rects_with_guys_h(game);
-	for(int i = 0; i < rwgw * rwgh; i++) {
-		RectWithGuys *rect = &game->rects_with_guys[i];
-		rect->amount = 0;
+void
+game_free(Game *game) {
+	if (game->workers != NULL) {
+		game_stop_workers(game);
 	}
 
-	AliveGuy *g = &game->guys[0];
-	g->x = 50;
-	g->y = 0;
-	g->cells[5 * ALIVEGUY_CELLS_W + 5] = Producer;
-	g->cells[6 * ALIVEGUY_CELLS_H + 6] = Eater;
-	g->hp = 50;
-	game->alives = 1;
-	aliveguy_calculate_new_lifetime(g);
-	game_aliveguy_register_birth(game, g);
+	AliveGuys *guys = &game->guys;
+	free(guys->x);
+	free(guys->y);
+	free(guys->death_tick);
+	free(guys->wheel_next);
+	free(guys->wheel_prev);
+	free(guys->hp);
+	free(guys->food_consumed);
+	free(guys->moving_direction);
+	free(guys->moving_frames_left);
+	free(guys->rect_index);
+	free(guys->rng);
+	free(guys->genome);
+	genome_table_free(&game->genomes);
+	free(guys->free_slots);
+	free(guys->alive_slots);
+	free(guys->alive_slots_pos);
+	free(game->births);
+	free(game->dying);
+	free(game->death_wheel);
+
+	free(game->map->food);
+	free(game->map->wall);
+	free(game->map->occupied);
+	for (int i = 0; i < game->map->chunks_w * game->map->chunks_h; i++) {
+		free(game->map->chunks[i].occupants);
+		free(game->map->chunks[i].dirty);
+	}
+	free(game->map->chunks);
+	free(game->map);
+
+	free(game);
 }
 
 void
-game_render(Game *game) {
-	tilemap_render(game->map);
-	for (int i = 0; i < GUYS_N; i++) {
-		AliveGuy *guy = &game->guys[i];
-		if(guy->hp > 0) {
-			aliveguy_render(guy);
+game_setup_scenario(Game *game, Scenario scenario, u64 seed) {
+	AliveGuys *guys = &game->guys;
+	TileMap *map = game->map;
+	assert(guys->alives == 1);
+	int founder = guys->alive_slots[0];
+
+	switch (scenario) {
+	case ScenarioFounder : break;
+	case ScenarioEmpty : {
+		game_aliveguy_register_death(game, founder);
+		game_free_aliveguy(game, founder);
+	} break;
+	case ScenarioDense : {
+		// founders every 3 tiles, leaving an eighth of the pool for
+		// their children. their lifetimes are spread out so they don't
+		// all die on the same tick
+		Genome *genome = aliveguy_genome(game, founder);
+		Body *body = &genome->body;
+		int limit = guys->capacity - guys->capacity / 8;
+		Rng rng;
+		rng_seed(&rng, seed);
+
+		for (int y = 1; y < map->h && guys->alives < limit; y += 3) {
+			for (int x = 1; x < map->w && guys->alives < limit; x += 3) {
+				int ox = x - body->start_x;
+				int oy = y - body->start_y;
+				if (!aliveguy_is_spot_vacant(genome, ox, oy, -1, game)) {
+					continue;
+				}
+
+				int g = game_new_aliveguy(game);
+				aliveguy_init(game, g);
+				rng_seed(&guys->rng[g], ((u64) rng_next(&rng) << 32) |
+					 rng_next(&rng));
+				guys->x[g] = ox;
+				guys->y[g] = oy;
+				guys->genome[g] = guys->genome[founder];
+				genome_acquire(&game->genomes, guys->genome[g]);
+				guys->hp[g] = 50;
+				aliveguy_set_lifetime(game, g, 1 + rng_below(
+					&guys->rng[g], genome->lifetime));
+				game_aliveguy_register_birth(game, g);
+			}
+		}
+	} break;
+	case ScenarioWalls : {
+		// walls every 40 tiles both ways, each 40 tile stretch with an 8
+		// tile gap in the middle. nothing's placed where the founder is
+		int spacing = 40;
+		int gap = 8;
+		for (int y = spacing; y < map->h; y += spacing) {
+			tilemap_fill_region(map, 0, y, map->w, 1, Wall);
+			for (int x = 0; x < map->w; x += spacing) {
+				tilemap_fill_region(map, x + (spacing - gap) / 2, y,
+						    gap, 1, Empty);
+			}
+		}
+		for (int x = spacing; x < map->w; x += spacing) {
+			tilemap_fill_region(map, x, 0, 1, map->h, Wall);
+			for (int y = 0; y < map->h; y += spacing) {
+				tilemap_fill_region(map, x, y + (spacing - gap) / 2,
+						    1, gap, Empty);
+			}
 		}
+		assert(aliveguy_is_spot_vacant(aliveguy_genome(game, founder),
+					       guys->x[founder], guys->y[founder],
+					       founder, game));
+	} break;
+	default : assert(0);
 	}
 }
 
-AliveGuy *
+#ifndef HEADLESS
+void
+game_render(Game *game) {
+	tilemap_render(game);
+
+	// as big as fits in the window, keeping tiles square
+	int out_w, out_h;
+	SDL_GetCurrentRenderOutputSize(ren, &out_w, &out_h);
+	float scale_x = (float) out_w / game->map->w;
+	float scale_y = (float) out_h / game->map->h;
+	float scale = scale_x < scale_y ? scale_x : scale_y;
+
+	SDL_FRect dst = {
+		0,
+		0,
+		game->map->w * scale,
+		game->map->h * scale
+	};
+	SDL_RenderTexture(ren, map_texture, NULL, &dst);
+}
+#endif
+
+// takes a slot from the pool and counts it as alive, -1 when full
+int
 game_new_aliveguy(Game *game) {
-	for (int i = 0; i < GUYS_N; i++) {
-		AliveGuy *guy = &game->guys[i];
-		if(guy->hp <= 0) {
-			return guy;
-		}
+	AliveGuys *guys = &game->guys;
+	if (guys->free_amount == 0) {
+		return -1;
 	}
-	return NULL;
+
+	guys->free_amount -= 1;
+	int index = guys->free_slots[guys->free_amount];
+
+	guys->alive_slots_pos[index] = guys->alives;
+	guys->alive_slots[guys->alives] = index;
+	guys->alives += 1;
+
+	return index;
 }
 
 void
-game_update(Game *game) {
-	for (int i = 0; i < GUYS_N; i++) {
-		AliveGuy *guy = &game->guys[i];
-		if(guy->hp > 0) {
-			aliveguy_update(guy, i, game);
-		}
-	}
+game_free_aliveguy(Game *game, int index) {
+	AliveGuys *guys = &game->guys;
+	int pos = guys->alive_slots_pos[index];
+	assert(pos != -1);
+
+	game_unschedule_death(game, index);
+	guys->alives -= 1;
+	int last = guys->alive_slots[guys->alives];
+	guys->alive_slots[pos] = last;
+	guys->alive_slots_pos[last] = pos;
+	guys->alive_slots_pos[index] = -1;
+
+	genome_release(&game->genomes, guys->genome[index]);
+	guys->genome[index] = -1;
+
+	guys->free_slots[guys->free_amount] = index;
+	guys->free_amount += 1;
 }
 
-int main() {
-	srand(time(NULL));
-	SDL_Init(SDL_INIT_VIDEO);
-	win = SDL_CreateWindow(
-		"title", 800, 600,
-		0
-		//| SDL_WINDOW_RESIZABLE
-		);
-	ren = SDL_CreateRenderer(win, NULL);
-	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+// the per guy arrays a snapshot stores, in the order it stores them
+void
+snapshot_guy_fields(AliveGuys *guys, SnapshotField *fields) {
+	SnapshotField f[SNAPSHOT_GUY_FIELDS] = {
+		{ guys->x,                  sizeof(int)  },
+		{ guys->y,                  sizeof(int)  },
+		{ guys->death_tick,         sizeof(u64)  },
+		{ guys->hp,                 sizeof(int)  },
+		{ guys->food_consumed,      sizeof(int)  },
+		{ guys->moving_direction,   sizeof(u8)   },
+		{ guys->moving_frames_left, sizeof(u8)   },
+		{ guys->rng,                sizeof(Rng)  },
+		// the guy's genome's body, stored whole
+		{ NULL,                     sizeof(Body) },
+	};
+	memcpy(fields, f, sizeof(f));
+}
 
-	Game game;
-	game_init(&game);
+// writes to path.tmp and renames it over path, so a crash never leaves
+// half a snapshot behind. false, with a message, if it couldn't
+bool
+game_save(Game *game, char *path) {
+	AliveGuys *guys = &game->guys;
+	TileMap *map = game->map;
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.tick = game->tick;
+	header.w = map->w;
+	header.h = map->h;
+	header.row_words = map->row_words;
+	header.capacity = guys->capacity;
+	header.alives = guys->alives;
+	header.free_amount = guys->free_amount;
+	header.mutation_chance_percent = game->mutation_chance_percent;
+	header.body_size = sizeof(Body);
+
+	SnapshotField fields[SNAPSHOT_GUY_FIELDS];
+	snapshot_guy_fields(guys, fields);
+
+	u64 plane_size = sizeof(u64) * map->row_words * map->h;
+	header.sizes[0] = plane_size;
+	header.sizes[1] = plane_size;
+	header.sizes[2] = sizeof(int) * guys->alives;
+	header.sizes[3] = sizeof(int) * guys->free_amount;
+	for (int i = 0; i < SNAPSHOT_GUY_FIELDS; i++) {
+		header.sizes[4 + i] = fields[i].size * guys->alives;
+	}
 
-	long tick = 0;
-	long last_tick = 0;
-	long current_tick = 0;
+	u64 offset = sizeof(header);
+	for (int i = 0; i < SNAPSHOT_SECTIONS; i++) {
+		offset = (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+		header.offsets[i] = offset;
+		offset += header.sizes[i];
+	}
+	header.file_size = offset;
 
-	bool running = true;
+	// the alive guys' fields are gathered into scratch first
+	u8 *scratch = my_malloc(sizeof(Body) * (guys->alives > 0 ? guys->alives : 1));
+	void *sections[SNAPSHOT_SECTIONS] = {
+		map->food, map->wall, guys->alive_slots, guys->free_slots
+	};
 
-	while (running) {
-		current_tick = SDL_GetTicks();
-		if (current_tick - last_tick > (1000/60.0)) {
-			tick++;
-			last_tick = current_tick;
-
-			while (SDL_PollEvent(&ev)) {
-				switch(ev.type) {
-				case SDL_EVENT_QUIT : {
-					running = 0;
-				} break;
-				}
-			}
-			game_update(&game);
+	size_t tmp_path_len = strlen(path) + 5;
+	char *tmp_path = my_malloc(tmp_path_len);
+	snprintf(tmp_path, tmp_path_len, "%s.tmp", path);
 
-			SDL_SetRenderDrawColor(ren, 0x18, 0x18, 0x18, 0xff);
-			SDL_RenderClear(ren);
+	FILE *f = fopen(tmp_path, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "couldn't write %s: %s\n", tmp_path, strerror(errno));
+		free(scratch);
+		free(tmp_path);
+		return false;
+	}
 
-			game_render(&game);
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	u64 written = sizeof(header);
+	static const u8 zeros[SNAPSHOT_ALIGN];
+	for (int i = 0; i < SNAPSHOT_SECTIONS && ok; i++) {
+		ok = fwrite(zeros, 1, header.offsets[i] - written, f) ==
+			header.offsets[i] - written;
+		written = header.offsets[i];
+
+		void *data = sections[i];
+		if (i >= 4) {
+			SnapshotField *field = &fields[i - 4];
+			for (int j = 0; j < guys->alives; j++) {
+				int slot = guys->alive_slots[j];
+				void *value = field->base == NULL ? (void *) aliveguy_body(game, slot) :
+					(u8 *) field->base + field->size * slot;
+				memcpy(scratch + field->size * j, value, field->size);
+			}
+			data = scratch;
+		}
 
-			SDL_RenderPresent(ren);
-		} else {
-			SDL_Delay(1000/60.0 - (current_tick - last_tick));
+		if (ok && header.sizes[i] > 0) {
+			ok = fwrite(data, header.sizes[i], 1, f) == 1;
 		}
+		written += header.sizes[i];
+	}
+
+	ok = fclose(f) == 0 && ok;
+	if (ok && rename(tmp_path, path) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		fprintf(stderr, "couldn't write %s: %s\n", path, strerror(errno));
+		remove(tmp_path);
+	}
+
+	free(scratch);
+	free(tmp_path);
+	return ok;
+}
+
+// maps the snapshot at path and builds a game from it, without workers.
+// NULL, with a message, when the file isn't a snapshot this build reads
+Game *
+game_load(char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "couldn't open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SnapshotHeader)) {
+		fprintf(stderr, "%s: not a snapshot\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	u8 *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "couldn't map %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	Game *game = NULL;
+	char *error = NULL;
+	SnapshotHeader *header = (SnapshotHeader *) data;
+	// the free slots seen so far, one bit each
+	u64 *free_seen = NULL;
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+		error = "not a snapshot";
+		goto DONE;
+	}
+	if (header->version != SNAPSHOT_VERSION ||
+	    header->byte_order != SNAPSHOT_BYTE_ORDER ||
+	    header->body_size != sizeof(Body)) {
+		error = "snapshot from another version or machine";
+		goto DONE;
+	}
+	if (header->file_size != (u64) st.st_size ||
+	    header->w < MAP_MIN_SIZE || header->h < MAP_MIN_SIZE ||
+	    (i64) header->w * header->h > MAP_MAX_TILES ||
+	    header->capacity < 1 || header->capacity > GUYS_MAX ||
+	    header->alives < 0 || header->free_amount < 0 ||
+	    (i64) header->alives + header->free_amount != header->capacity) {
+		error = "corrupt header";
+		goto DONE;
+	}
+
+	// every section has to be the size the header's numbers make it and
+	// lie inside the file, before anything's allocated from them
+	AliveGuys no_guys;
+	memset(&no_guys, 0, sizeof(no_guys));
+	SnapshotField fields[SNAPSHOT_GUY_FIELDS];
+	snapshot_guy_fields(&no_guys, fields);
+
+	u64 row_words = tilemap_row_words(header->w);
+	u64 plane_size = sizeof(u64) * row_words * header->h;
+	u64 expected_sizes[SNAPSHOT_SECTIONS] = {
+		plane_size,
+		plane_size,
+		sizeof(int) * (u64) header->alives,
+		sizeof(int) * (u64) header->free_amount,
+	};
+	for (int i = 0; i < SNAPSHOT_GUY_FIELDS; i++) {
+		expected_sizes[4 + i] = fields[i].size * (u64) header->alives;
+	}
+	if ((u64) header->row_words != row_words) {
+		error = "corrupt header";
+		goto DONE;
+	}
+	for (int i = 0; i < SNAPSHOT_SECTIONS; i++) {
+		// written so neither side can wrap around
+		if (header->sizes[i] != expected_sizes[i] ||
+		    header->offsets[i] % SNAPSHOT_ALIGN != 0 ||
+		    header->offsets[i] > header->file_size ||
+		    header->sizes[i] > header->file_size - header->offsets[i]) {
+			error = "corrupt header";
+			goto DONE;
+		}
+	}
+
+	game = my_malloc(sizeof(Game));
+	game_alloc(game, header->w, header->h, header->capacity);
+	game->tick = header->tick;
+	game->mutation_chance_percent = header->mutation_chance_percent;
+
+	AliveGuys *guys = &game->guys;
+	TileMap *map = game->map;
+	snapshot_guy_fields(guys, fields);
+
+	memcpy(map->food, data + header->offsets[0], plane_size);
+	memcpy(map->wall, data + header->offsets[1], plane_size);
+
+	int *alive_slots = (int *) (data + header->offsets[2]);
+	int *free_slots = (int *) (data + header->offsets[3]);
+
+	guys->alives = 0;
+	for (int j = 0; j < header->alives; j++) {
+		int slot = alive_slots[j];
+		if (slot < 0 || slot >= guys->capacity ||
+		    guys->alive_slots_pos[slot] != -1) {
+			error = "corrupt alive slots";
+			goto DONE;
+		}
+		guys->alive_slots[j] = slot;
+		guys->alive_slots_pos[slot] = j;
+		guys->alives += 1;
+	}
+
+	free_seen = malloc(sizeof(u64) * ((guys->capacity + 63) / 64));
+	memset(free_seen, 0, sizeof(u64) * ((guys->capacity + 63) / 64));
+	for (int j = 0; j < header->free_amount; j++) {
+		int slot = free_slots[j];
+		if (slot < 0 || slot >= guys->capacity ||
+		    guys->alive_slots_pos[slot] != -1 ||
+		    (free_seen[slot / 64] & ((u64) 1 << (slot % 64)))) {
+			error = "corrupt free slots";
+			goto DONE;
+		}
+		free_seen[slot / 64] |= (u64) 1 << (slot % 64);
+		guys->free_slots[j] = slot;
+	}
+	guys->free_amount = header->free_amount;
+
+	u8 *bodies = NULL;
+	for (int i = 0; i < SNAPSHOT_GUY_FIELDS; i++) {
+		u8 *src = data + header->offsets[4 + i];
+		if (fields[i].base == NULL) {
+			bodies = src;
+			continue;
+		}
+		for (int j = 0; j < guys->alives; j++) {
+			memcpy((u8 *) fields[i].base + fields[i].size * guys->alive_slots[j],
+			       src + fields[i].size * j, fields[i].size);
+		}
+	}
+
+	// the body's cached values are recalculated rather than trusted,
+	// and every guy has to be on the map and not overlap the ones put
+	// back before it. the tiles under it aren't checked, producers can
+	// drop food under their neighbours. a guy never holds more food than
+	// it needs plus what its eaters can get in a tick. genomes are made
+	// afresh, so species stats start over
+	assert(bodies != NULL);
+	for (int j = 0; j < guys->alives; j++) {
+		int g = guys->alive_slots[j];
+		Body body;
+		memcpy(&body, bodies + sizeof(Body) * j, sizeof(Body));
+		body_recalculate(&body);
+		if (body.cells_amount < 1 || guys->moving_direction[g] >= DirectionN ||
+		    guys->death_tick[g] < game->tick || guys->death_tick[g] == 0 ||
+		    !(-ALIVEGUY_CELLS_W < guys->x[g] && guys->x[g] < map->w) ||
+		    !(-ALIVEGUY_CELLS_H < guys->y[g] && guys->y[g] < map->h) ||
+		    guys->hp[g] <= 0) {
+			error = "corrupt guys";
+			goto DONE;
+		}
+		guys->genome[g] = genome_intern(&game->genomes, &body, game->tick);
+		Genome *genome = genome_get(&game->genomes, guys->genome[g]);
+		if (guys->food_consumed[g] < 0 ||
+		    guys->food_consumed[g] > genome->food_needed + 4 * body.cells_amount) {
+			error = "corrupt guys";
+			goto DONE;
+		}
+
+		BodyIter it;
+		BodyCell bc;
+		body_iter_init(&it, &body);
+		while (body_iter_next(&it, &bc)) {
+			int x = guys->x[g] + bc.x;
+			int y = guys->y[g] + bc.y;
+			if (!(0 < x && x < map->w && 0 < y && y < map->h) ||
+			    tilemap_get_occupant(map, x, y) != -1) {
+				error = "corrupt guys";
+				goto DONE;
+			}
+		}
+
+		guys->rect_index[g] = -1;
+		game_aliveguy_register_birth(game, g);
+		game_schedule_death(game, g);
+	}
+
+	profile_reset(&game->profile);
+
+DONE:
+	free(free_seen);
+	munmap(data, st.st_size);
+	if (error != NULL) {
+		fprintf(stderr, "%s: %s\n", path, error);
+		if (game != NULL) {
+			game_free(game);
+		}
+		return NULL;
+	}
+	return game;
+}
+
+void
+game_start_workers(Game *game, int threads) {
+	assert(game->workers == NULL);
+	if (threads <= 1) {
+		return;
+	}
+
+	Workers *w = malloc(sizeof(Workers));
+	w->game = game;
+
+	int rects_w = game_get_rects_with_guys_w(game);
+	int rects_h = game_get_rects_with_guys_h(game);
+	w->blocks_w = (rects_w + PARALLEL_BLOCK_RECTS - 1) / PARALLEL_BLOCK_RECTS;
+	w->blocks_h = (rects_h + PARALLEL_BLOCK_RECTS - 1) / PARALLEL_BLOCK_RECTS;
+
+	int blocks_amount = w->blocks_w * w->blocks_h;
+	w->blocks = malloc(sizeof(Block) * blocks_amount);
+	for (int i = 0; i < blocks_amount; i++) {
+		profile_reset(&w->blocks[i].profile);
+	}
+	w->guys = malloc(sizeof(int) * game->guys.capacity);
+	w->phase_blocks = malloc(sizeof(int) * blocks_amount);
+	w->phase_blocks_amount = 0;
+
+	// the calling thread works too
+	w->threads_amount = threads - 1;
+	w->threads = malloc(sizeof(thrd_t) * w->threads_amount);
+	mtx_init(&w->lock, mtx_plain);
+	cnd_init(&w->start);
+	cnd_init(&w->done);
+	w->generation = 0;
+	w->running = 0;
+	w->quit = false;
+
+	for (int i = 0; i < w->threads_amount; i++) {
+		int ret = thrd_create(&w->threads[i], workers_thread, w);
+		assert(ret == thrd_success);
+	}
+
+	game->workers = w;
+}
+
+void
+workers_take_blocks(Workers *w) {
+	for (;;) {
+		int i = atomic_fetch_add(&w->next_phase_block, 1);
+		if (i >= w->phase_blocks_amount) {
+			return;
+		}
+		block_update(w->game, &w->blocks[w->phase_blocks[i]]);
+	}
+}
+
+void
+game_stop_workers(Game *game) {
+	Workers *w = game->workers;
+	assert(w != NULL);
+
+	mtx_lock(&w->lock);
+	w->quit = true;
+	cnd_broadcast(&w->start);
+	mtx_unlock(&w->lock);
+
+	for (int i = 0; i < w->threads_amount; i++) {
+		thrd_join(w->threads[i], NULL);
+	}
+
+	mtx_destroy(&w->lock);
+	cnd_destroy(&w->start);
+	cnd_destroy(&w->done);
+
+	free(w->blocks);
+	free(w->guys);
+	free(w->phase_blocks);
+	free(w->threads);
+	free(w);
+
+	game->workers = NULL;
+}
+
+int
+workers_thread(void *arg) {
+	Workers *w = arg;
+	int generation = 0;
+
+	mtx_lock(&w->lock);
+	for (;;) {
+		while (w->generation == generation && !w->quit) {
+			cnd_wait(&w->start, &w->lock);
+		}
+		if (w->quit) {
+			break;
+		}
+		generation = w->generation;
+		mtx_unlock(&w->lock);
+
+		workers_take_blocks(w);
+
+		mtx_lock(&w->lock);
+		w->running -= 1;
+		if (w->running == 0) {
+			cnd_signal(&w->done);
+		}
+	}
+	mtx_unlock(&w->lock);
+
+	return 0;
+}
+
+// runs every block in phase_blocks and returns once they're all done
+void
+workers_run_phase(Workers *w) {
+	atomic_store(&w->next_phase_block, 0);
+
+	mtx_lock(&w->lock);
+	w->generation += 1;
+	w->running = w->threads_amount;
+	cnd_broadcast(&w->start);
+	mtx_unlock(&w->lock);
+
+	workers_take_blocks(w);
+
+	mtx_lock(&w->lock);
+	while (w->running > 0) {
+		cnd_wait(&w->done, &w->lock);
+	}
+	mtx_unlock(&w->lock);
+}
+
+void
+block_update(Game *game, Block *block) {
+	Workers *w = game->workers;
+
+	current_block = block;
+	for (int i = 0; i < block->guys_amount; i++) {
+		int index = w->guys[block->guys_start + i];
+		aliveguy_update(game, index);
+	}
+	current_block = NULL;
+}
+
+void
+game_update_parallel(Game *game) {
+	Workers *w = game->workers;
+	int rects_w = game_get_rects_with_guys_w(game);
+	int blocks_amount = w->blocks_w * w->blocks_h;
+
+	// hand out the alive guys to their home blocks, keeping their order
+	for (int b = 0; b < blocks_amount; b++) {
+		w->blocks[b].guys_amount = 0;
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (int j = 0; j < game->guys.alives; j++) {
+			int i = game->guys.alive_slots[j];
+
+			int rx = game->guys.rect_index[i] % rects_w;
+			int ry = game->guys.rect_index[i] / rects_w;
+			int b = (ry / PARALLEL_BLOCK_RECTS) * w->blocks_w +
+				rx / PARALLEL_BLOCK_RECTS;
+			Block *block = &w->blocks[b];
+
+			if (pass == 1) {
+				w->guys[block->guys_start + block->guys_amount] = i;
+			}
+			block->guys_amount += 1;
+		}
+
+		if (pass == 0) {
+			int start = 0;
+			for (int b = 0; b < blocks_amount; b++) {
+				w->blocks[b].guys_start = start;
+				start += w->blocks[b].guys_amount;
+				w->blocks[b].guys_amount = 0;
+			}
+		}
+	}
+
+	for (int py = 0; py < PARALLEL_PHASE_STRIDE; py++) {
+		for (int px = 0; px < PARALLEL_PHASE_STRIDE; px++) {
+			w->phase_blocks_amount = 0;
+			for (int by = py; by < w->blocks_h; by += PARALLEL_PHASE_STRIDE) {
+				for (int bx = px; bx < w->blocks_w; bx += PARALLEL_PHASE_STRIDE) {
+					int b = by * w->blocks_w + bx;
+					if (w->blocks[b].guys_amount > 0) {
+						w->phase_blocks[w->phase_blocks_amount] = b;
+						w->phase_blocks_amount += 1;
+					}
+				}
+			}
+
+			if (w->phase_blocks_amount == 0) {
+				continue;
+			}
+
+			workers_run_phase(w);
+
+			for (int i = 0; i < w->phase_blocks_amount; i++) {
+				Block *block = &w->blocks[w->phase_blocks[i]];
+				profile_add(&game->profile, &block->profile);
+				profile_reset(&block->profile);
+			}
+		}
+	}
+}
+
+// the children asked for this tick go in in alive slot order, each where
+// its parent wanted it unless a child placed before took the spot or the
+// pool is full. they wait for the next tick to move
+void
+game_place_births(Game *game) {
+	AliveGuys *guys = &game->guys;
+	int amount = guys->alives;
+	for (int j = 0; j < amount; j++) {
+		int parent = guys->alive_slots[j];
+		BirthRequest req = game->births[parent];
+		if (req.parent == -1) {
+			continue;
+		}
+		game->births[parent].parent = -1;
+
+		if (aliveguy_is_spot_vacant(aliveguy_genome(game, parent),
+					    req.x, req.y, -1, game)) {
+			aliveguy_birth(game, parent, req.x, req.y);
+		}
+	}
+}
+
+void
+game_update(Game *game) {
+	u64 start = profile_start(game);
+
+	game_kill_due(game);
+
+	if (game->workers != NULL) {
+		game_update_parallel(game);
+	} else {
+		for (int j = 0; j < game->guys.alives; j++) {
+			aliveguy_update(game, game->guys.alive_slots[j]);
+		}
+	}
+
+	game_place_births(game);
+
+	profile_stop(game, PhaseTick, start);
+	game->profile.ticks += 1;
+
+	if (game->log != NULL && game->tick % EVENTLOG_FOOD_TICKS == 0) {
+		game_log_food(game);
+	}
+	if (game->tick % TILEMAP_CHUNK_FREE_TICKS == 0) {
+		tilemap_free_empty_chunks(game->map);
+	}
+	game->tick += 1;
+}
+
+double
+now_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+u64
+now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// where the calling thread's numbers go
+Profile *
+game_profile(Game *game) {
+	return current_block != NULL ? &current_block->profile : &game->profile;
+}
+
+u64
+profile_start(Game *game) {
+	return game->profiling ? now_ns() : 0;
+}
+
+void
+profile_stop(Game *game, ProfilePhase phase, u64 start) {
+	if (game->profiling) {
+		game_profile(game)->ns[phase] += now_ns() - start;
+	}
+}
+
+void
+profile_reset(Profile *profile) {
+	memset(profile, 0, sizeof(Profile));
+}
+
+void
+profile_add(Profile *dst, Profile *src) {
+	for (int i = 0; i < PhasesN; i++) {
+		dst->ns[i] += src->ns[i];
+	}
+	dst->ticks += src->ticks;
+	dst->frames += src->frames;
+	dst->point_vacant_calls += src->point_vacant_calls;
+	dst->spot_vacant_calls += src->spot_vacant_calls;
+}
+
+// one line of averages: microseconds per tick for the update's phases,
+// per frame for render, and vacancy checks per tick
+void
+profile_print(Profile *profile, long tick, int alives, bool json, bool header) {
+	double ticks = profile->ticks > 0 ? profile->ticks : 1;
+	double frames = profile->frames > 0 ? profile->frames : 1;
+
+	if (header && !json) {
+		printf("tick,alive");
+		for (int i = 0; i < PhasesN; i++) {
+			printf(",%s_us", profile_phase_names[i]);
+		}
+		printf(",point_vacant,spot_vacant\n");
+	}
+
+	printf(json ? "{\"tick\": %ld, \"alive\": %d" : "%ld,%d", tick, alives);
+	for (int i = 0; i < PhasesN; i++) {
+		double us = profile->ns[i] / 1000.0 / (i == PhaseRender ? frames : ticks);
+		if (json) {
+			printf(", \"%s_us\": %.3f", profile_phase_names[i], us);
+		} else {
+			printf(",%.3f", us);
+		}
+	}
+	printf(json ? ", \"point_vacant\": %.1f, \"spot_vacant\": %.1f}\n" :
+	       ",%.1f,%.1f\n",
+	       profile->point_vacant_calls / ticks,
+	       profile->spot_vacant_calls / ticks);
+	fflush(stdout);
+}
+
+#ifndef HEADLESS
+void
+profile_render_overlay(Profile *profile, int alives) {
+	double ticks = profile->ticks > 0 ? profile->ticks : 1;
+	double frames = profile->frames > 0 ? profile->frames : 1;
+	int line_h = 10;
+
+	SDL_FRect bg = { 0, 0, 8 * 30 + 8, line_h * (PhasesN + 5) + 8 };
+	SDL_SetRenderDrawColor(ren, 0x00, 0x00, 0x00, 0xb0);
+	SDL_RenderFillRect(ren, &bg);
+
+	SDL_SetRenderDrawColor(ren, 0xff, 0xff, 0xff, 0xff);
+	float y = 4;
+	SDL_RenderDebugTextFormat(ren, 4, y, "alive %d, %ld ticks %ld frames",
+				  alives, profile->ticks, profile->frames);
+	y += line_h * 2;
+	for (int i = 0; i < PhasesN; i++) {
+		double us = profile->ns[i] / 1000.0 / (i == PhaseRender ? frames : ticks);
+		SDL_RenderDebugTextFormat(ren, 4, y, "%-10s %10.1f us/%s",
+					  profile_phase_names[i], us,
+					  i == PhaseRender ? "frame" : "tick");
+		y += line_h;
+	}
+	y += line_h;
+	SDL_RenderDebugTextFormat(ren, 4, y, "point vacant %9.1f /tick",
+				  profile->point_vacant_calls / ticks);
+	y += line_h;
+	SDL_RenderDebugTextFormat(ren, 4, y, "spot vacant  %9.1f /tick",
+				  profile->spot_vacant_calls / ticks);
+}
+#endif
+
+void
+options_init(Options *opts) {
+	opts->ticks = -1;
+	opts->seconds = -1;
+	opts->tps = 60;
+	opts->fps = 60;
+	opts->threads = 1;
+	opts->seed = time(NULL);
+	opts->width = MAP_W;
+	opts->height = MAP_H;
+	opts->capacity = GUYS_N;
+	opts->scenario = ScenarioFounder;
+	opts->load_path = NULL;
+	opts->log_path = NULL;
+	opts->snapshot_path = "life.snap";
+	opts->save_every = 0;
+	opts->profile_every = 0;
+	opts->profile_json = false;
+	opts->species = 0;
+}
+
+void
+options_usage(char *argv0) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --ticks N      stop after N ticks (headless)\n"
+		"  --seconds S    stop after S seconds (headless)\n"
+		"  --tps N        ticks per second, or `unlimited` (window)\n"
+		"  --fps N        frames per second, 0 draws only on r (window)\n"
+		"  --threads N    update in parallel on N threads\n"
+		"  --seed N       seed of the world, the time by default\n"
+		"  --width N      map width in tiles, at least %d\n"
+		"  --height N     map height in tiles, at least %d\n"
+		"  --capacity N   most guys alive at once\n"
+		"  --scenario S   founder (default), empty, dense or walls\n"
+		"  --load FILE    carry on from a snapshot\n"
+		"  --log FILE     log births, deaths, mutations and food to FILE\n"
+		"  --print-log FILE  print a log as csv and exit\n"
+		"  --snapshot FILE  where snapshots go, life.snap by default\n"
+		"  --save-every N   write a snapshot every N ticks (headless)\n"
+		"  --profile N    print where the time went every N ticks (headless)\n"
+		"  --json         print the profile as json lines, not csv\n"
+		"  --species N    list the N biggest species at the end (headless)\n",
+		argv0, MAP_MIN_SIZE, MAP_MIN_SIZE);
+	exit(1);
+}
+
+void
+options_parse(Options *opts, int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		char *arg = argv[i];
+		char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--ticks") == 0 && val != NULL) {
+			opts->ticks = atol(val);
+			i++;
+		} else if (strcmp(arg, "--seconds") == 0 && val != NULL) {
+			opts->seconds = atof(val);
+			i++;
+		} else if (strcmp(arg, "--tps") == 0 && val != NULL) {
+			opts->tps = strcmp(val, "unlimited") == 0 ? 0 : atof(val);
+			i++;
+		} else if (strcmp(arg, "--fps") == 0 && val != NULL) {
+			opts->fps = atof(val);
+			i++;
+		} else if (strcmp(arg, "--threads") == 0 && val != NULL) {
+			opts->threads = atoi(val);
+			i++;
+		} else if (strcmp(arg, "--seed") == 0 && val != NULL) {
+			opts->seed = strtoull(val, NULL, 10);
+			i++;
+		} else if (strcmp(arg, "--width") == 0 && val != NULL) {
+			opts->width = atoi(val);
+			i++;
+		} else if (strcmp(arg, "--height") == 0 && val != NULL) {
+			opts->height = atoi(val);
+			i++;
+		} else if (strcmp(arg, "--capacity") == 0 && val != NULL) {
+			opts->capacity = atoi(val);
+			i++;
+		} else if (strcmp(arg, "--scenario") == 0 && val != NULL) {
+			opts->scenario = ScenariosN;
+			for (int s = 0; s < ScenariosN; s++) {
+				if (strcmp(val, scenario_names[s]) == 0) {
+					opts->scenario = s;
+				}
+			}
+			if (opts->scenario == ScenariosN) {
+				options_usage(argv[0]);
+			}
+			i++;
+		} else if (strcmp(arg, "--load") == 0 && val != NULL) {
+			opts->load_path = val;
+			i++;
+		} else if (strcmp(arg, "--log") == 0 && val != NULL) {
+			opts->log_path = val;
+			i++;
+		} else if (strcmp(arg, "--print-log") == 0 && val != NULL) {
+			exit(eventlog_print(val));
+		} else if (strcmp(arg, "--snapshot") == 0 && val != NULL) {
+			opts->snapshot_path = val;
+			i++;
+		} else if (strcmp(arg, "--save-every") == 0 && val != NULL) {
+			opts->save_every = atol(val);
+			i++;
+		} else if (strcmp(arg, "--profile") == 0 && val != NULL) {
+			opts->profile_every = atol(val);
+			i++;
+		} else if (strcmp(arg, "--species") == 0 && val != NULL) {
+			opts->species = atoi(val);
+			i++;
+		} else if (strcmp(arg, "--json") == 0) {
+			opts->profile_json = true;
+		} else {
+			options_usage(argv[0]);
+		}
+	}
+
+	if (opts->width < MAP_MIN_SIZE || opts->height < MAP_MIN_SIZE ||
+	    (i64) opts->width * opts->height > MAP_MAX_TILES ||
+	    opts->capacity < 1 || opts->capacity > GUYS_MAX) {
+		options_usage(argv[0]);
+	}
+}
+
+// NULL, with a message, if path can't be written
+EventLog *
+eventlog_open(char *path) {
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "couldn't write %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	char magic[8] = EVENTLOG_MAGIC;
+	u32 version = EVENTLOG_VERSION;
+	u32 event_size = sizeof(Event);
+	fwrite(magic, sizeof(magic), 1, file);
+	fwrite(&version, sizeof(version), 1, file);
+	fwrite(&event_size, sizeof(event_size), 1, file);
+
+	EventLog *log = my_malloc(sizeof(EventLog));
+	log->file = file;
+	log->filling = my_malloc(sizeof(Event) * EVENTLOG_CHUNK);
+	log->filling_amount = 0;
+	log->queued_amount = 0;
+	log->spare = NULL;
+	log->spare_amount = 0;
+	log->spare_capacity = 0;
+	log->quit = false;
+	log->failed = false;
+	mtx_init(&log->lock, mtx_plain);
+	cnd_init(&log->wake);
+	cnd_init(&log->drained);
+
+	int ret = thrd_create(&log->writer, eventlog_writer, log);
+	assert(ret == thrd_success);
+
+	return log;
+}
+
+// only ever called by the thread running the tick
+void
+eventlog_push(EventLog *log, Event *event) {
+	log->filling[log->filling_amount] = *event;
+	log->filling_amount += 1;
+	if (log->filling_amount == EVENTLOG_CHUNK) {
+		eventlog_hand_over(log);
+	}
+}
+
+// queues the chunk being filled for the writer and takes an empty one,
+// waiting if the writer is too far behind
+void
+eventlog_hand_over(EventLog *log) {
+	mtx_lock(&log->lock);
+	while (log->queued_amount == EVENTLOG_MAX_QUEUED) {
+		cnd_wait(&log->drained, &log->lock);
+	}
+
+	log->queued[log->queued_amount] = log->filling;
+	log->queued_amount += 1;
+	cnd_signal(&log->wake);
+
+	Event *next = NULL;
+	if (log->spare_amount > 0) {
+		log->spare_amount -= 1;
+		next = log->spare[log->spare_amount];
+	}
+	mtx_unlock(&log->lock);
+
+	log->filling = next != NULL ? next : my_malloc(sizeof(Event) * EVENTLOG_CHUNK);
+	log->filling_amount = 0;
+}
+
+int
+eventlog_writer(void *arg) {
+	EventLog *log = arg;
+
+	mtx_lock(&log->lock);
+	for (;;) {
+		while (log->queued_amount == 0 && !log->quit) {
+			cnd_wait(&log->wake, &log->lock);
+		}
+		if (log->queued_amount == 0) {
+			break;
+		}
+
+		Event *chunk = log->queued[0];
+		mtx_unlock(&log->lock);
+
+		if (!log->failed &&
+		    fwrite(chunk, sizeof(Event), EVENTLOG_CHUNK, log->file) != EVENTLOG_CHUNK) {
+			fprintf(stderr, "couldn't write the event log: %s\n",
+				strerror(errno));
+			log->failed = true;
+		}
+
+		mtx_lock(&log->lock);
+		log->queued_amount -= 1;
+		memmove(&log->queued[0], &log->queued[1],
+			sizeof(Event *) * log->queued_amount);
+		if (log->spare_amount == log->spare_capacity) {
+			log->spare_capacity = log->spare_capacity == 0 ?
+				4 : log->spare_capacity * 2;
+			log->spare = my_realloc(log->spare,
+						sizeof(Event *) * log->spare_capacity);
+		}
+		log->spare[log->spare_amount] = chunk;
+		log->spare_amount += 1;
+		cnd_signal(&log->drained);
+	}
+	mtx_unlock(&log->lock);
+
+	return 0;
+}
+
+// waits for the writer to catch up, writes what's left and closes the file
+void
+eventlog_close(EventLog *log) {
+	mtx_lock(&log->lock);
+	log->quit = true;
+	cnd_signal(&log->wake);
+	mtx_unlock(&log->lock);
+	thrd_join(log->writer, NULL);
+
+	if (!log->failed && log->filling_amount > 0) {
+		fwrite(log->filling, sizeof(Event), log->filling_amount, log->file);
+	}
+	fclose(log->file);
+
+	for (int i = 0; i < log->spare_amount; i++) {
+		free(log->spare[i]);
+	}
+	free(log->spare);
+	free(log->filling);
+	mtx_destroy(&log->lock);
+	cnd_destroy(&log->wake);
+	cnd_destroy(&log->drained);
+	free(log);
+}
+
+// prints the log at path as csv, returns the exit code
+int
+eventlog_print(char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "couldn't open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	char magic[8];
+	u32 version, event_size;
+	if (fread(magic, sizeof(magic), 1, file) != 1 ||
+	    fread(&version, sizeof(version), 1, file) != 1 ||
+	    fread(&event_size, sizeof(event_size), 1, file) != 1 ||
+	    memcmp(magic, EVENTLOG_MAGIC, sizeof(magic)) != 0 ||
+	    version != EVENTLOG_VERSION || event_size != sizeof(Event)) {
+		fprintf(stderr, "%s: not an event log this build reads\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	char *mutation_names[MutationsN] = { "add", "change", "remove" };
+
+	printf("tick,type,guy,x,y,value,kind,from,to\n");
+	Event e;
+	while (fread(&e, sizeof(e), 1, file) == 1) {
+		if (e.type >= EventTypesN) {
+			fprintf(stderr, "%s: corrupt event\n", path);
+			fclose(file);
+			return 1;
+		}
+		printf("%llu,%s,%d,%d,%d,%lld,%s,%d,%d\n",
+		       (unsigned long long) e.tick, event_type_names[e.type],
+		       e.guy, e.x, e.y, (long long) e.value,
+		       e.type == EventMutation && e.kind < MutationsN ?
+		       mutation_names[e.kind] : "",
+		       e.from, e.to);
+	}
+
+	fclose(file);
+	return 0;
+}
+
+// births, deaths, mutations and food all happen outside the parallel
+// phases, so this never runs on a worker
+void
+game_log_event(Game *game, Event *event) {
+	assert(current_block == NULL);
+	event->tick = game->tick;
+	eventlog_push(game->log, event);
+}
+
+void
+game_log_birth(Game *game, int child, int parent) {
+	if (game->log == NULL) {
+		return;
+	}
+
+	Event e;
+	memset(&e, 0, sizeof(e));
+	e.type = EventBirth;
+	e.guy = child;
+	e.x = game->guys.x[child];
+	e.y = game->guys.y[child];
+	e.value = parent;
+	game_log_event(game, &e);
+}
+
+void
+game_log_death(Game *game, int index) {
+	if (game->log == NULL) {
+		return;
+	}
+
+	Event e;
+	memset(&e, 0, sizeof(e));
+	e.type = EventDeath;
+	e.guy = index;
+	e.x = game->guys.x[index];
+	e.y = game->guys.y[index];
+	e.value = aliveguy_body(game, index)->cells_amount;
+	game_log_event(game, &e);
+}
+
+void
+game_log_mutation(Game *game, int index, Mutation kind, int x, int y,
+		  CellType from, CellType to) {
+	if (game->log == NULL) {
+		return;
+	}
+
+	Event e;
+	memset(&e, 0, sizeof(e));
+	e.type = EventMutation;
+	e.guy = index;
+	e.x = x;
+	e.y = y;
+	e.kind = kind;
+	e.from = from;
+	e.to = to;
+	game_log_event(game, &e);
+}
+
+void
+game_log_food(Game *game) {
+	if (game->log == NULL) {
+		return;
+	}
+
+	Event e;
+	memset(&e, 0, sizeof(e));
+	e.type = EventFood;
+	e.guy = game->guys.alives;
+	e.value = tilemap_count_food(game->map, 0, 0, game->map->w, game->map->h);
+	game_log_event(game, &e);
+}
+
+// the snapshot asked for, or a new world, with its workers running
+Game *
+game_from_options(Options *opts) {
+	Game *game;
+	if (opts->load_path != NULL) {
+		game = game_load(opts->load_path);
+		if (game == NULL) {
+			exit(1);
+		}
+	} else {
+		game = malloc(sizeof(Game));
+		game_init(game, opts->seed, opts->width, opts->height, opts->capacity);
+		game_setup_scenario(game, opts->scenario, opts->seed);
+	}
+
+	if (opts->log_path != NULL) {
+		game->log = eventlog_open(opts->log_path);
+		if (game->log == NULL) {
+			exit(1);
+		}
+	}
+
+	game_start_workers(game, opts->threads);
+	return game;
+}
+
+#ifdef HEADLESS
+// steps the simulation as fast as it can until one of the limits is hit
+// or everybody is dead
+int main(int argc, char *argv[]) {
+	Options opts;
+	options_init(&opts);
+	options_parse(&opts, argc, argv);
+
+	Game *game = game_from_options(&opts);
+	game->profiling = opts.profile_every > 0;
+
+	long tick = 0;
+	// guys updated over the whole run, summed over the ticks
+	long guy_updates = 0;
+	double start = now_seconds();
+	double elapsed = 0;
+
+	while (opts.ticks < 0 || tick < opts.ticks) {
+		if (opts.seconds >= 0 && elapsed >= opts.seconds) {
+			break;
+		}
+		if (game->guys.alives == 0 && opts.scenario != ScenarioEmpty) {
+			printf("everybody died at tick %ld.\n", tick);
+			break;
+		}
+
+		guy_updates += game->guys.alives;
+		game_update(game);
+		tick++;
+		elapsed = now_seconds() - start;
+
+		if (opts.profile_every > 0 && tick % opts.profile_every == 0) {
+			profile_print(&game->profile, tick, game->guys.alives,
+				      opts.profile_json, tick == opts.profile_every);
+			profile_reset(&game->profile);
+		}
+
+		if (opts.save_every > 0 && game->tick % opts.save_every == 0) {
+			game_save(game, opts.snapshot_path);
+		}
+	}
+
+	if (game->log != NULL) {
+		eventlog_close(game->log);
+		game->log = NULL;
+	}
+
+	// ru_maxrss is in KiB on linux
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	if (opts.species > 0) {
+		genome_table_print_species(&game->genomes, opts.species);
+	}
+
+	// a snapshot carries its guys' rngs, not the seed its world was
+	// made from, so loaded runs have no seed to show
+	if (opts.load_path != NULL) {
+		printf("%s, ", opts.load_path);
+	} else {
+		printf("%s, seed %llu, ", scenario_names[opts.scenario],
+		       (unsigned long long) opts.seed);
+	}
+	printf("ticks %ld, seconds %.3f, ticks/s %.1f, "
+	       "ns/guy %.1f, alive %d, species %d, peak rss %ld KiB\n",
+	       tick, elapsed, elapsed > 0 ? tick / elapsed : 0.0,
+	       guy_updates > 0 ? elapsed * 1e9 / guy_updates : 0.0,
+	       game->guys.alives, game->genomes.species, usage.ru_maxrss);
+
+	return 0;
+}
+#else
+int main(int argc, char *argv[]) {
+	Options opts;
+	options_init(&opts);
+	options_parse(&opts, argc, argv);
+
+	SDL_Init(SDL_INIT_VIDEO);
+	win = SDL_CreateWindow(
+		"title", 800, 600,
+		0
+		//| SDL_WINDOW_RESIZABLE
+		);
+	ren = SDL_CreateRenderer(win, NULL);
+	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+
+	if (opts.load_path == NULL) {
+		printf("seed %llu\n", (unsigned long long) opts.seed);
+	}
+
+	Game *game = game_from_options(&opts);
+
+	// keys: + / - double or halve the tick rate, u toggles unlimited
+	// ticks, r draws a frame right away, p toggles the profile overlay,
+	// s saves a snapshot and l loads it back
+	double tps = opts.tps;
+	double unlimited_tps = 60;
+	double accumulator = 0;
+	double last_time = now_seconds();
+	double last_frame = -1;
+	bool frame_requested = true;
+
+	Profile shown_profile;
+	profile_reset(&shown_profile);
+	double profile_since = last_time;
+
+	bool running = true;
+
+	while (running) {
+		while (SDL_PollEvent(&ev)) {
+			switch(ev.type) {
+			case SDL_EVENT_QUIT : {
+				running = 0;
+			} break;
+			case SDL_EVENT_KEY_DOWN : {
+				switch (ev.key.key) {
+				case SDLK_EQUALS : if (tps > 0) { tps *= 2; } break;
+				case SDLK_MINUS  : if (tps > 1) { tps /= 2; } break;
+				case SDLK_R      : frame_requested = true; break;
+				case SDLK_P : {
+					game->profiling = !game->profiling;
+					profile_reset(&game->profile);
+					profile_reset(&shown_profile);
+					profile_since = now_seconds();
+					frame_requested = true;
+				} break;
+				case SDLK_S : {
+					if (game_save(game, opts.snapshot_path)) {
+						printf("saved tick %llu to %s\n",
+						       (unsigned long long) game->tick,
+						       opts.snapshot_path);
+					}
+				} break;
+				case SDLK_L : {
+					Game *loaded = game_load(opts.snapshot_path);
+					if (loaded == NULL) {
+						break;
+					}
+					loaded->profiling = game->profiling;
+					loaded->log = game->log;
+					game_free(game);
+					game = loaded;
+					game_start_workers(game, opts.threads);
+					tilemap_render_reset();
+					frame_requested = true;
+					printf("loaded tick %llu from %s\n",
+					       (unsigned long long) game->tick,
+					       opts.snapshot_path);
+				} break;
+				case SDLK_U : {
+					if (tps > 0) {
+						unlimited_tps = tps;
+						tps = 0;
+					} else {
+						tps = unlimited_tps;
+					}
+				} break;
+				}
+			} break;
+			}
+		}
+
+		double now = now_seconds();
+		double slice_end = now + SIM_SLICE_SECONDS;
+		accumulator += now - last_time;
+		last_time = now;
+
+		if (tps <= 0) {
+			do {
+				game_update(game);
+			} while (now_seconds() < slice_end);
+			accumulator = 0;
+		} else {
+			double tick_dt = 1 / tps;
+			while (accumulator >= tick_dt && now_seconds() < slice_end) {
+				game_update(game);
+				accumulator -= tick_dt;
+			}
+			if (accumulator > tick_dt * SIM_MAX_BACKLOG_TICKS) {
+				accumulator = tick_dt * SIM_MAX_BACKLOG_TICKS;
+			}
+		}
+
+		now = now_seconds();
+		bool frame_due = opts.fps > 0 && now - last_frame >= 1 / opts.fps;
+		if (frame_due || frame_requested) {
+			frame_requested = false;
+			last_frame = now;
+
+			SDL_SetRenderDrawColor(ren, 0x18, 0x18, 0x18, 0xff);
+			SDL_RenderClear(ren);
+
+			u64 render_start = profile_start(game);
+			game_render(game);
+			profile_stop(game, PhaseRender, render_start);
+			game->profile.frames += 1;
+
+			if (game->profiling) {
+				if (now - profile_since >= PROFILE_OVERLAY_SECONDS) {
+					shown_profile = game->profile;
+					profile_reset(&game->profile);
+					profile_since = now;
+				}
+				profile_render_overlay(&shown_profile, game->guys.alives);
+			}
+
+			SDL_RenderPresent(ren);
+		}
+
+		// sleep until the next tick or frame is due
+		if (tps > 0) {
+			double wait = 1 / tps - accumulator;
+			if (opts.fps > 0) {
+				double frame_wait = last_frame + 1 / opts.fps - now;
+				if (frame_wait < wait) {
+					wait = frame_wait;
+				}
+			}
+			if (wait > 0.001) {
+				SDL_Delay(wait * 1000);
+			}
+		}
+	}
+
+	if (game->log != NULL) {
+		eventlog_close(game->log);
 	}
 
 	SDL_DestroyRenderer(ren);
@@ -999,3 +3668,4 @@ int main() {
 
 	return 0;
 }
+#endif